@@ -2,6 +2,7 @@
 #define APPLICATION_HPP
 
 #include <event_stream.h>
+#include <render_jobs.h>
 #include <render_thread.h>
 #include <resource_container.h>
 #include <scene/scene.h>
@@ -34,6 +35,7 @@ namespace rt
             {
                 std::filesystem::path path;
                 m::u64vec2            size;
+                int                   priority = 0;
             };
             struct CloseApplication
             {
@@ -55,7 +57,11 @@ namespace rt
 
         std::map<std::string, std::unique_ptr<Renderer>> renderers;
 
-        ThreadPool<std::packaged_task<void()>> threadPool;
+        WorkStealingPool<std::packaged_task<void()>> threadPool;
+        // Loads and decodes resources with background priority, so it never holds up the workers rendering tiles
+        WorkStealingPool<std::packaged_task<void()>> loaderPool;
+        // Renders output jobs with background priority next to the previews
+        WorkStealingPool<std::packaged_task<void()>> jobPool;
 
         ResourceContainer resources;
 
@@ -65,10 +71,16 @@ namespace rt
 
         RenderThread renderThread;
 
+        RenderJobQueue renderJobs;
+
         std::optional<std::filesystem::path> savePath;
 
         m::u64vec2                           outputSize = {1920, 1080};
         std::optional<std::filesystem::path> outputPath;
+        // Written next to every output as <name>.heatmap.jpg, see Renderer::writeHeatmap
+        RenderParams::Heatmap outputHeatmap = RenderParams::NoHeatmap;
+        // Frame reports of headless and benchmark runs are written there as JSON at their end, see Profiling::FrameReport
+        std::optional<std::filesystem::path> reportPath;
 
         bool useGui = true;
 
@@ -85,10 +97,14 @@ namespace rt
                     bool                                 useGui = true,
                     std::optional<std::filesystem::path> sceneFile = std::nullopt,
                     std::optional<std::filesystem::path> outputPath = std::nullopt,
-                    m::u64vec2                           outputSize = {1920, 1080});
+                    m::u64vec2                           outputSize = {1920, 1080},
+                    std::optional<size_t>                loaderThreads = std::nullopt,
+                    const CpuTopology::PlacementOptions &placement = {});
         ~Application();
 
         void run();
+        // Renders every scene in resource/scenes with every renderer and prints the frame times, frames has to be at least 1
+        void benchmark(size_t frames);
 
         template <class T>
         Application &operator<<(T event)
@@ -98,7 +114,8 @@ namespace rt
         }
 
     private:
-        void renderOutput(const std::filesystem::path &path, m::u64vec2 size);
+        // Queues a render job of the current scene, returns its id
+        uint64_t renderOutput(const std::filesystem::path &path, m::u64vec2 size, int priority = 0, bool profile = false);
 
         void loadScene(const std::filesystem::path &path);
         void saveScene(const std::filesystem::path &path);
@@ -0,0 +1,258 @@
+#ifndef BVH_HPP
+#define BVH_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include <ray_packet.h>
+#include <rtmath.h>
+
+namespace rt
+{
+    namespace m = math;
+
+    // Bounding volume hierarchy over a list of bounding boxes, built with the surface area heuristic.
+    // The hierarchy only stores indices into the list it was built from.
+    // Nodes are stored with the scalar type T, that rays are traversed with, the hierarchy is always built in double.
+    template <typename T>
+    class BasicBVH
+    {
+    public:
+        struct Node
+        {
+            // Rounded outwards when T is less precise than double, so it still contains all of its primitives
+            m::AABB<T> bounds;
+            // Leaf: index of the first primitive in the index list
+            // Inner node: index of the left child, the right child follows directly after it
+            uint32_t first;
+            // Number of primitives, 0 for inner nodes
+            uint32_t count;
+
+            inline bool isLeaf() const { return count != 0; }
+        };
+
+        static constexpr size_t MaxDepth = 64;
+
+    private:
+        std::vector<Node>     m_nodes;
+        std::vector<uint32_t> m_indices;
+        // Bounds of the primitives in the order of the index list, kept for refitting
+        std::vector<m::AABB<double>> m_bounds;
+
+    public:
+        void build(const std::vector<m::AABB<double>> &bounds);
+        void clear();
+
+        // Replaces the bounds of the primitive at position i of the index list, the nodes are only updated by refit
+        void setBounds(uint32_t i, const m::AABB<double> &bounds);
+        // Recomputes the node bounds bottom-up after primitives moved. The tree itself is kept, so it gets less efficient
+        // the further primitives move, build has to be called when primitives are added or removed.
+        void refit();
+
+        inline bool                         isEmpty() const { return m_nodes.empty(); }
+        inline const std::vector<Node>     &getNodes() const { return m_nodes; }
+        inline const std::vector<uint32_t> &getIndices() const { return m_indices; }
+
+        // Calls visit(index) for every primitive whose bounds are hit by the ray before tMax, nearest nodes first.
+        // visit may shrink tMax to cull the remaining nodes and returns true to stop the traversal.
+        template <typename F>
+        void traverse(const m::ray<T> &ray, T &tMax, F &&visit) const;
+        // Same as traverse, but calls visit(first, count) once per leaf with its range in the index list
+        template <typename F>
+        void traverseLeaves(const m::ray<T> &ray, T &tMax, F &&visit) const;
+        // Calls visit(first, count) for every leaf whose bounds are hit by any lane of the packet before the tMax of that lane.
+        // first and count are the range of the leaf in the index list, visit may shrink the tMax values to cull the remaining nodes.
+        template <typename F>
+        void traversePacketLeaves(const BasicRayPacket<T> &packet, const T *tMax, F &&visit) const;
+
+    private:
+        void subdivide(uint32_t nodeIndex, uint32_t first, uint32_t count, size_t depth,
+                       const std::vector<m::AABB<double>> &bounds, const std::vector<m::dvec3> &centroids);
+    };
+
+    extern template class BasicBVH<float>;
+    extern template class BasicBVH<double>;
+
+    using BVH = BasicBVH<double>;
+
+    // ---------- Implementation ----------
+
+    template <typename T>
+    template <typename F>
+    void BasicBVH<T>::traverse(const m::ray<T> &ray, T &tMax, F &&visit) const
+    {
+        traverseLeaves(ray, tMax, [&](uint32_t first, uint32_t count)
+                       {
+                           for (uint32_t i = first; i < first + count; i++)
+                               if (visit(m_indices[i]))
+                                   return true;
+                           return false; });
+    }
+
+    template <typename T>
+    template <typename F>
+    void BasicBVH<T>::traverseLeaves(const m::ray<T> &ray, T &tMax, F &&visit) const
+    {
+        if (m_nodes.empty())
+            return;
+
+        struct StackEntry
+        {
+            uint32_t node;
+            T        tEntry;
+        };
+
+        StackEntry stack[MaxDepth * 2];
+        size_t     stackSize = 0;
+
+        m::vec3<T> invDirection = T(1) / ray.direction;
+
+        T tEntry;
+        if (!m_nodes[0].bounds.intersect(ray, invDirection, tMax, &tEntry))
+            return;
+
+        const Node *node = &m_nodes[0];
+        while (true)
+        {
+            if (node->isLeaf())
+            {
+                if (visit(node->first, node->count))
+                    return;
+            }
+            else
+            {
+                const Node *left = &m_nodes[node->first];
+                const Node *right = &m_nodes[node->first + 1];
+
+                T    tLeft, tRight;
+                bool hitLeft = left->bounds.intersect(ray, invDirection, tMax, &tLeft);
+                bool hitRight = right->bounds.intersect(ray, invDirection, tMax, &tRight);
+
+                if (hitLeft && hitRight)
+                {
+                    // Visit the nearer child first, the other one may be culled when it is popped
+                    if (tRight < tLeft)
+                    {
+                        std::swap(left, right);
+                        std::swap(tLeft, tRight);
+                    }
+                    stack[stackSize++] = {(uint32_t)(right - m_nodes.data()), tRight};
+                    node = left;
+                    continue;
+                }
+                if (hitLeft)
+                {
+                    node = left;
+                    continue;
+                }
+                if (hitRight)
+                {
+                    node = right;
+                    continue;
+                }
+            }
+
+            // Pop the next node, that is still in front of the nearest hit
+            do
+            {
+                if (stackSize == 0)
+                    return;
+                stackSize--;
+            } while (stack[stackSize].tEntry > tMax);
+            node = &m_nodes[stack[stackSize].node];
+        }
+    }
+
+    template <typename T>
+    template <typename F>
+    void BasicBVH<T>::traversePacketLeaves(const BasicRayPacket<T> &packet, const T *tMax, F &&visit) const
+    {
+        if (m_nodes.empty())
+            return;
+
+        alignas(64) T invDirectionX[MaxPacketSize];
+        alignas(64) T invDirectionY[MaxPacketSize];
+        alignas(64) T invDirectionZ[MaxPacketSize];
+        for (size_t i = 0; i < packet.size; i++)
+        {
+            invDirectionX[i] = T(1) / packet.directionX[i];
+            invDirectionY[i] = T(1) / packet.directionY[i];
+            invDirectionZ[i] = T(1) / packet.directionZ[i];
+        }
+
+        // Nearest entry of all lanes into the bounds of the node, infinity if no lane hits them
+        auto intersectNode = [&](const Node &node)
+        {
+            const m::AABB<T> &b = node.bounds;
+
+            T nearest = INFINITY;
+            for (size_t i = 0; i < packet.size; i++)
+            {
+                T t0x = (b.min.x - packet.originX[i]) * invDirectionX[i];
+                T t1x = (b.max.x - packet.originX[i]) * invDirectionX[i];
+                T t0y = (b.min.y - packet.originY[i]) * invDirectionY[i];
+                T t1y = (b.max.y - packet.originY[i]) * invDirectionY[i];
+                T t0z = (b.min.z - packet.originZ[i]) * invDirectionZ[i];
+                T t1z = (b.max.z - packet.originZ[i]) * invDirectionZ[i];
+
+                T tEntry = std::max(std::max(std::min(t0x, t1x), std::min(t0y, t1y)), std::max(std::min(t0z, t1z), T(0)));
+                T tExit = std::min(std::min(std::max(t0x, t1x), std::max(t0y, t1y)), std::min(std::max(t0z, t1z), tMax[i]));
+
+                nearest = tEntry <= tExit ? std::min(nearest, tEntry) : nearest;
+            }
+            return nearest;
+        };
+
+        uint32_t stack[MaxDepth * 2];
+        size_t   stackSize = 0;
+
+        if (intersectNode(m_nodes[0]) == INFINITY)
+            return;
+
+        uint32_t node = 0;
+        while (true)
+        {
+            const Node &current = m_nodes[node];
+            if (current.isLeaf())
+                visit(current.first, current.count);
+            else
+            {
+                uint32_t left = current.first;
+                uint32_t right = current.first + 1;
+
+                T tLeft = intersectNode(m_nodes[left]);
+                T tRight = intersectNode(m_nodes[right]);
+
+                if (tLeft != INFINITY && tRight != INFINITY)
+                {
+                    // Visit the child, that is nearer to the packet first
+                    if (tRight < tLeft)
+                        std::swap(left, right);
+                    stack[stackSize++] = right;
+                    node = left;
+                    continue;
+                }
+                if (tLeft != INFINITY)
+                {
+                    node = left;
+                    continue;
+                }
+                if (tRight != INFINITY)
+                {
+                    node = right;
+                    continue;
+                }
+            }
+
+            // Pop the next node, that is still hit by any lane with the shrunk tMax values
+            do
+            {
+                if (stackSize == 0)
+                    return;
+                node = stack[--stackSize];
+            } while (intersectNode(m_nodes[node]) == INFINITY);
+        }
+    }
+} // namespace rt
+
+#endif // BVH_HPP
@@ -0,0 +1,48 @@
+#ifndef CHROME_TRACE_HPP
+#define CHROME_TRACE_HPP
+
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+#include <profiler.h>
+
+namespace Profiling
+{
+    // Writes frame profiles in the Chrome Trace Event format, that chrome://tracing and Perfetto open.
+    // Every frame is a span on a track of its own, the tasks of every thread are spans on one track per thread
+    // and the counters of the frames are counter tracks. Frames are appended as they come, the file is completed on destruction.
+    class ChromeTrace
+    {
+        std::ofstream m_file;
+        std::mutex    m_mutex;
+        bool          m_firstEvent = true;
+
+        // Timestamps are relative to the start of the first frame
+        std::optional<time_point> m_origin;
+        size_t                    m_frames = 0;
+
+        std::map<std::thread::id, size_t> m_threads;
+
+    public:
+        // Throws if the file can't be opened
+        ChromeTrace(const std::filesystem::path &path);
+        ~ChromeTrace();
+
+        ChromeTrace(const ChromeTrace &) = delete;
+        ChromeTrace &operator=(const ChromeTrace &) = delete;
+
+        void addFrame(const FrameProfile &profile);
+
+    private:
+        size_t getTrack(std::thread::id thread);
+
+        void beginEvent();
+        void writeSpan(const char *name, size_t track, time_point start, time_point end, const std::string &args = "");
+    };
+} // namespace Profiling
+
+#endif // CHROME_TRACE_HPP
@@ -0,0 +1,173 @@
+#ifndef COMPILED_SCENE_HPP
+#define COMPILED_SCENE_HPP
+
+#include <array>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include <bvh.h>
+#include <ray_packet.h>
+#include <scene/scene_shapes.h>
+
+namespace rt
+{
+    namespace m = math;
+
+    // Nearest hit of every lane of a ray packet
+    template <typename T>
+    struct BasicPacketHits
+    {
+        // Ray parameter of the nearest hit, initialized to the maximum distance
+        alignas(64) T            t[MaxPacketSize];
+        const SceneShape        *object[MaxPacketSize];
+        const Transform::Cached *transform[MaxPacketSize];
+        // Set for hits of generic and voxel shapes, their intersection (in local object space) is already known
+        bool         hasIntersection[MaxPacketSize];
+        Intersection intersections[MaxPacketSize];
+
+        BasicPacketHits()
+        {
+            for (size_t i = 0; i < MaxPacketSize; i++)
+            {
+                t[i] = INFINITY;
+                object[i] = nullptr;
+                transform[i] = nullptr;
+                hasIntersection[i] = false;
+            }
+        }
+    };
+
+    using PacketHits = BasicPacketHits<double>;
+
+    // Render ready representation of the shapes of a scene, built every frame from the editable SceneShapes.
+    // Shapes are sorted into buckets per type, that store their data in world space as structure of arrays,
+    // so rays are intersected in tight loops without virtual calls or matrix products per object.
+    // Every bounded bucket has its own BVH and its arrays are stored in the order of the BVH leaves.
+    // Every bucket keeps the revision of its shapes and their index in the shape list (sources),
+    // so moved shapes can be refit without rebuilding everything, even from another copy of the list.
+    // The matrices of the shapes are copied as well, queries never read the transforms of the scene,
+    // so the shapes can be prepared for the next frame while this one is still traced.
+    // Shapes, that don't fit into a specialized bucket, are intersected through SceneShape::intersect.
+    // T is the scalar type of the bucket data and the rays, generic shapes and the final hit are always computed in double.
+    template <typename T>
+    class BasicCompiledScene
+    {
+    public:
+        // Spheres with uniform scale
+        struct SphereBucket
+        {
+            std::vector<T>                  centerX, centerY, centerZ;
+            std::vector<T>                  radius2;
+            std::vector<const SceneShape *> shapes;
+            std::vector<Transform::Cached>  transforms;
+            std::vector<uint64_t>           revisions;
+            std::vector<uint32_t>           sources;
+            BasicBVH<T>                     bvh;
+        };
+
+        // Row of the inverse matrix, that gives the local y coordinate
+        struct PlaneBucket
+        {
+            std::vector<T>                  rowX, rowY, rowZ, rowW;
+            std::vector<const SceneShape *> shapes;
+            std::vector<Transform::Cached>  transforms;
+            std::vector<uint64_t>           revisions;
+            std::vector<uint32_t>           sources;
+        };
+
+        // Upper 3x4 part of the inverse matrix, inverse[row * 4 + column]
+        struct CubeBucket
+        {
+            std::array<std::vector<T>, 12>  inverse;
+            std::vector<const SceneShape *> shapes;
+            std::vector<Transform::Cached>  transforms;
+            std::vector<uint64_t>           revisions;
+            std::vector<uint32_t>           sources;
+            BasicBVH<T>                     bvh;
+        };
+
+        // Two level structure for voxel grids: the bucket BVH is the top level over the instance bounds,
+        // the brick map and distance field of the shared grid resource are the bottom level.
+        // An instance is only its shape, referencing the resource and its transform, nothing is built per instance.
+        struct VoxelBucket
+        {
+            std::vector<const Shapes::VoxelShape *> shapes;
+            std::vector<Transform::Cached>          transforms;
+            std::vector<uint64_t>                   revisions;
+            std::vector<uint32_t>                   sources;
+            BasicBVH<T>                             bvh;
+        };
+
+        struct GenericBucket
+        {
+            std::vector<const SceneShape *> shapes;
+            std::vector<Transform::Cached>  transforms;
+            std::vector<uint64_t>           revisions;
+            std::vector<uint32_t>           sources;
+            BasicBVH<T>                     bvh;
+            // Shapes without finite bounds
+            std::vector<const SceneShape *> unbounded;
+            std::vector<Transform::Cached>  unboundedTransforms;
+            std::vector<uint32_t>           unboundedSources;
+        };
+
+    private:
+        // Nearest hit of a single ray
+        struct Hit
+        {
+            T                        t;
+            const SceneShape        *object = nullptr;
+            const Transform::Cached *transform = nullptr;
+            // Only set for generic and voxel shapes, in local object space
+            std::optional<Intersection> intersection;
+        };
+
+        SphereBucket  m_spheres;
+        PlaneBucket   m_planes;
+        CubeBucket    m_cubes;
+        VoxelBucket   m_voxels;
+        GenericBucket m_generic;
+
+        // Voxel shapes, whose grid wasn't loaded yet when the scene was built, by index in the shape list
+        std::vector<uint32_t> m_pendingVoxels;
+        // Structure revision of the scene, that was passed to build
+        uint64_t m_structureRevision = UINT64_MAX;
+
+    public:
+        // Requires the cached transform matrices of the shapes to be up to date
+        void build(const std::vector<std::shared_ptr<SceneShape>> &shapes, uint64_t structureRevision = 0);
+        void clear();
+        // Updates the shapes, whose revision changed since they were compiled, and refits the BVHs bottom-up.
+        // shapes has to have the same structure as the list it was built from, e.g. a newer snapshot of it.
+        // Returns false if the scene has to be rebuilt instead, e.g. because a shape doesn't fit into its bucket anymore.
+        bool refit(const std::vector<std::shared_ptr<SceneShape>> &shapes);
+
+        inline uint64_t getStructureRevision() const { return m_structureRevision; }
+
+        // Ray is in world space, tMax is the maximum ray parameter
+        std::optional<Intersection> castRay(const m::ray<T> &ray, T tMax) const;
+        bool                        occluded(const m::ray<T> &ray, T tMax) const;
+
+        void                        castPacket(const BasicRayPacket<T> &packet, BasicPacketHits<T> &hits) const;
+        std::optional<Intersection> resolvePacketHit(const BasicRayPacket<T> &packet, const BasicPacketHits<T> &hits, size_t i) const;
+
+        inline const SphereBucket  &getSpheres() const { return m_spheres; }
+        inline const PlaneBucket   &getPlanes() const { return m_planes; }
+        inline const CubeBucket    &getCubes() const { return m_cubes; }
+        inline const VoxelBucket   &getVoxels() const { return m_voxels; }
+        inline const GenericBucket &getGeneric() const { return m_generic; }
+
+    private:
+        // Full intersection details of the nearest hit in world space
+        std::optional<Intersection> resolve(const m::ray<T> &ray, const SceneShape *object, const Transform::Cached &transform,
+                                            const std::optional<Intersection> &intersection) const;
+    };
+
+    extern template class BasicCompiledScene<float>;
+    extern template class BasicCompiledScene<double>;
+
+    using CompiledScene = BasicCompiledScene<double>;
+} // namespace rt
+
+#endif // COMPILED_SCENE_HPP
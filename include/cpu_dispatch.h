@@ -0,0 +1,91 @@
+#ifndef CPU_DISPATCH_HPP
+#define CPU_DISPATCH_HPP
+
+#include <optional>
+#include <string_view>
+
+// Hot kernels are compiled once per instruction set, the variant is chosen once at startup.
+// Only GCC and Clang support compiling single functions for other instruction sets,
+// other compilers only get the generic variant.
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define RT_CPU_DISPATCH
+// flatten inlines everything called by the kernel, so the whole kernel is compiled for the instruction set
+#define RT_TARGET_AVX2 __attribute__((target("avx2,fma"), flatten))
+#define RT_TARGET_AVX512 __attribute__((target("avx512f,avx512dq,avx512vl,avx2,fma"), flatten))
+#endif
+
+namespace rt
+{
+    namespace CpuDispatch
+    {
+        enum class Isa
+        {
+            Generic,
+            AVX2,
+            AVX512,
+            Isa_COUNT,
+        };
+
+        const char        *isaToString(Isa isa);
+        std::optional<Isa> isaFromString(std::string_view name);
+
+        // Best instruction set supported by this CPU, that kernels are compiled for
+        Isa detectIsa();
+
+        // Selects the kernel variants, must be called before any kernel runs.
+        // Throws if the forced instruction set is not supported by this CPU.
+        void selectIsa(std::optional<Isa> forced = std::nullopt);
+        Isa  getIsa();
+
+        template <typename F>
+        inline F select(F generic, F avx2, F avx512)
+        {
+            switch (getIsa())
+            {
+            case Isa::AVX512:
+                return avx512;
+            case Isa::AVX2:
+                return avx2;
+            default:
+                return generic;
+            }
+        }
+    } // namespace CpuDispatch
+} // namespace rt
+
+// Defines the dispatched kernel name, that forwards to name##Body compiled for the selected instruction set.
+// params is the parenthesized parameter list, args the parenthesized argument list.
+#ifdef RT_CPU_DISPATCH
+#define RT_KERNEL(ret, name, params, args)                                                                   \
+    static ret name##Generic params { return name##Body args; }                                              \
+    RT_TARGET_AVX2 static ret name##AVX2 params { return name##Body args; }                                  \
+    RT_TARGET_AVX512 static ret name##AVX512 params { return name##Body args; }                              \
+    static ret name params                                                                                   \
+    {                                                                                                        \
+        static const auto variant = ::rt::CpuDispatch::select(&name##Generic, &name##AVX2, &name##AVX512); \
+        return variant args;                                                                                 \
+    }
+
+// Same as RT_KERNEL for a kernel templated on the scalar type T, name##Body has to be a template on T as well
+#define RT_KERNEL_TEMPLATE(ret, name, T, params, args)                                                                \
+    template <typename T>                                                                                             \
+    static ret name##Generic params { return name##Body<T> args; }                                                    \
+    template <typename T>                                                                                             \
+    RT_TARGET_AVX2 static ret name##AVX2 params { return name##Body<T> args; }                                        \
+    template <typename T>                                                                                             \
+    RT_TARGET_AVX512 static ret name##AVX512 params { return name##Body<T> args; }                                    \
+    template <typename T>                                                                                             \
+    static ret name params                                                                                            \
+    {                                                                                                                 \
+        static const auto variant = ::rt::CpuDispatch::select(&name##Generic<T>, &name##AVX2<T>, &name##AVX512<T>); \
+        return variant args;                                                                                          \
+    }
+#else
+#define RT_KERNEL(ret, name, params, args) \
+    static inline ret name params { return name##Body args; }
+#define RT_KERNEL_TEMPLATE(ret, name, T, params, args) \
+    template <typename T>                              \
+    static inline ret name params { return name##Body<T> args; }
+#endif
+
+#endif // CPU_DISPATCH_HPP
@@ -0,0 +1,75 @@
+#ifndef CPU_TOPOLOGY_HPP
+#define CPU_TOPOLOGY_HPP
+
+#include <optional>
+#include <string_view>
+#include <vector>
+
+namespace rt
+{
+    namespace CpuTopology
+    {
+        struct Cpu
+        {
+            // Logical cpu number of the OS
+            int id;
+            // Physical core and socket, logical cpus of the same core are SMT siblings
+            int core;
+            int package;
+            // Index into the NUMA nodes of the topology
+            size_t node;
+        };
+
+        struct Topology
+        {
+            std::vector<Cpu> cpus;
+            size_t           nodeCount = 1;
+        };
+
+        // Reads the online cpus, their cores and NUMA nodes from /sys on Linux.
+        // Elsewhere, or if /sys is not available, every cpu is its own core on a single node.
+        const Topology &getTopology();
+
+        enum class Pinning
+        {
+            // Workers may run on any cpu, the OS places them
+            None,
+            // Every worker is bound to one cpu
+            Cores,
+            // Every worker is bound to the cpus of one NUMA node
+            Nodes,
+            Pinning_COUNT,
+        };
+
+        const char            *pinningToString(Pinning pinning);
+        std::optional<Pinning> pinningFromString(std::string_view name);
+
+        struct PlacementOptions
+        {
+            // 0 starts one worker per usable cpu
+            size_t  threadCount = 0;
+            Pinning pinning = Pinning::None;
+            // Whether workers may use all SMT siblings of a core or only the first one
+            bool useSmt = true;
+        };
+
+        // Where a worker of a pool runs
+        struct WorkerPlacement
+        {
+            // Cpus the worker is bound to, empty if it isn't pinned
+            std::vector<int> cpus;
+            // Index of the NUMA node of the topology the worker belongs to, always 0 for unpinned workers
+            size_t node = 0;
+        };
+
+        // Spreads the workers evenly over the NUMA nodes, the workers of a node are placed on distinct cores first.
+        // Only cpus in the affinity mask of the process are used, nodes without any of them get no workers.
+        std::vector<WorkerPlacement> placeWorkers(const PlacementOptions &options);
+
+        // Binds the calling thread to the given cpus, does nothing if they are empty or pinning isn't supported.
+        // Returns false if the OS refused to bind the thread.
+        bool pinCurrentThread(const std::vector<int> &cpus);
+    } // namespace CpuTopology
+} // namespace rt
+
+#endif // CPU_TOPOLOGY_HPP
@@ -0,0 +1,98 @@
+#ifndef FRAME_ARENA_HPP
+#define FRAME_ARENA_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace rt
+{
+    // Bump allocator for the scratch memory of the render path, every thread has an arena of its own, see local().
+    // Allocations are never freed one by one, a Scope rewinds the arena to where it was created and the whole arena
+    // is reset on its first use in a new frame outside of any scope. Once the arena is large enough for a frame, it doesn't allocate anymore.
+    class FrameArena
+    {
+    public:
+        // Rewinds the arena to its state at construction once it leaves its scope, scopes have to be nested
+        class Scope
+        {
+            FrameArena &m_arena;
+            size_t      m_block;
+            size_t      m_offset;
+
+        public:
+            Scope(FrameArena &arena);
+            ~Scope();
+
+            Scope(const Scope &) = delete;
+            Scope &operator=(const Scope &) = delete;
+        };
+
+    private:
+        static constexpr size_t MinBlockSize = 64 * 1024;
+
+        struct Block
+        {
+            std::unique_ptr<std::byte[]> data;
+            size_t                       size;
+        };
+
+        // The blocks are used in order, blocks behind the current one stay allocated for later use
+        std::vector<Block> m_blocks;
+        size_t             m_block = 0;
+        size_t             m_offset = 0;
+        // Open scopes, the arena is only reset once they are closed
+        size_t   m_depth = 0;
+        uint64_t m_frame = 0;
+
+        inline static std::atomic<uint64_t> s_frame = 0;
+
+    public:
+        FrameArena() = default;
+        FrameArena(const FrameArena &) = delete;
+        FrameArena &operator=(const FrameArena &) = delete;
+
+        // Arena of the calling thread
+        static FrameArena &local();
+        // Starts a new frame, the arenas of all threads are reset on their next use outside of a scope.
+        // Scratch memory, that isn't held by a scope, must not be used after this.
+        static void nextFrame();
+
+        void *allocate(size_t size, size_t alignment);
+        // Releases everything allocated so far, the blocks are merged into one, that fits all of them
+        void reset();
+
+        size_t getCapacity() const;
+    };
+
+    // Allocator for standard containers, that takes its memory from a FrameArena, deallocating does nothing
+    template <typename T>
+    class FrameAllocator
+    {
+        template <typename U>
+        friend class FrameAllocator;
+
+        FrameArena *m_arena;
+
+    public:
+        using value_type = T;
+
+        FrameAllocator(FrameArena &arena = FrameArena::local())
+            : m_arena(&arena) {}
+        template <typename U>
+        FrameAllocator(const FrameAllocator<U> &other)
+            : m_arena(other.m_arena) {}
+
+        inline T   *allocate(size_t n) { return static_cast<T *>(m_arena->allocate(n * sizeof(T), alignof(T))); }
+        inline void deallocate(T *, size_t) {}
+
+        template <typename U>
+        inline bool operator==(const FrameAllocator<U> &other) const { return m_arena == other.m_arena; }
+    };
+
+    template <typename T>
+    using FrameVector = std::vector<T, FrameAllocator<T>>;
+} // namespace rt
+
+#endif // FRAME_ARENA_HPP
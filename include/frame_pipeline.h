@@ -0,0 +1,48 @@
+#ifndef FRAME_PIPELINE_HPP
+#define FRAME_PIPELINE_HPP
+
+#include <functional>
+#include <memory>
+
+#include <renderer.h>
+#include <work_stealing_pool.h>
+
+namespace rt
+{
+    // Renders a sequence of frames with overlapping stages. While frame N is traced on the calling thread and the pool,
+    // frame N + 1 is prepared and frame N - 1 is post-processed and presented by tasks on the pool:
+    //
+    //   prepare N+1 | trace N | post-process N-1, present N-1
+    //
+    // Consecutive frames use alternating slots of the compiled scenes, see Scene::FrameSlots.
+    class FramePipeline
+    {
+    public:
+        using FrameContext = Renderer::FrameContext;
+
+        // Returns the next frame. With wait set no frame is traced or prepared and it blocks until there is one, nullptr ends the pipeline.
+        // Otherwise it is asked before a frame is traced and returns nullptr if there is no next frame yet.
+        std::function<std::unique_ptr<FrameContext>(bool wait)> next;
+        // Called on the calling thread right before a frame is prepared, while no other frame is prepared, optional.
+        // The frame, that is traced next, may already be prepared.
+        std::function<void()> frameBoundary;
+        // Called on the calling thread right before and after a frame is traced, optional
+        std::function<void(FrameContext &frame)>                beforeTrace;
+        std::function<void(FrameContext &frame, bool finished)> afterTrace;
+        // Called on a worker of the pool once a frame is post-processed, in the order of the frames, optional.
+        // Cancelled frames are neither post-processed nor presented.
+        std::function<void(std::unique_ptr<FrameContext> frame)> present;
+
+    private:
+        size_t m_nextSlot = 0;
+
+    public:
+        // Returns once next returned nullptr while waiting and all frames were presented
+        void run(WorkStealingPool<Renderer::task_type> &threadPool);
+
+    private:
+        std::future<void> submit(WorkStealingPool<Renderer::task_type> &threadPool, std::function<void()> function);
+    };
+} // namespace rt
+
+#endif // FRAME_PIPELINE_HPP
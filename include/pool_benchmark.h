@@ -0,0 +1,14 @@
+#ifndef POOL_BENCHMARK_HPP
+#define POOL_BENCHMARK_HPP
+
+#include <cstddef>
+
+namespace rt
+{
+    // Compares the scaling of ThreadPool and WorkStealingPool from 1 to maxThreads threads and prints the times.
+    // Runs a flat workload of many small tasks like the tile rendering, the same items with WorkStealingPool::parallelFor,
+    // and a nested fork/join workload like parallel builds.
+    void benchmarkThreadPools(size_t maxThreads);
+} // namespace rt
+
+#endif // POOL_BENCHMARK_HPP
@@ -1,7 +1,10 @@
 #ifndef PROFILER_HPP
 #define PROFILER_HPP
 
+#include <atomic>
 #include <chrono>
+#include <deque>
+#include <functional>
 #include <map>
 #include <memory>
 #include <mutex>
@@ -16,6 +19,10 @@ namespace Profiling
     std::ostream &operator<<(std::ostream &stream, const duration &duration);
     std::ostream &operator<<(std::ostream &stream, const time_point &timePoint);
 
+    // Heap allocations since the start of the process and of the calling thread, see allocation_counter.cpp
+    uint64_t getAllocations();
+    uint64_t getThreadAllocations();
+
     struct Task
     {
         const char *Label;
@@ -23,6 +30,10 @@ namespace Profiling
         time_point start;
         time_point end;
 
+        // Heap allocations of the thread during the task.
+        // Only counted for tasks, that were ended on their own thread, the last task of a thread is ended by endFrame.
+        uint64_t allocations = 0;
+
         Task(const char *label, time_point start, time_point end = time_point());
 
         inline duration getTime() const { return end - start; }
@@ -35,26 +46,150 @@ namespace Profiling
         std::map<std::thread::id, std::vector<Task>> tasks;
         time_point                                   start;
         time_point                                   end;
+
+        // Set if a newer frame was requested before this one finished
+        bool cancelled = false;
+        // Frames cancelled since the last finished frame and the time spent on them
+        size_t   cancelledFrames = 0;
+        duration cancelledTime = duration::zero();
+
+        // Values measured over the whole frame, e.g. rays per second
+        std::vector<std::pair<const char *, double>> counters;
+
+        // Sum of the allocations of all tasks
+        uint64_t getAllocations() const;
     };
 
     std::ostream &operator<<(std::ostream &stream, const FrameProfile &profile);
 
+    // Rolling statistics over the last finished frames: percentiles of the frame time and how much of it every thread
+    // spent rendering, handing out tiles and waiting, taken from the spans of the threads, see Renderer::render.
+    class FrameReport
+    {
+    public:
+        struct ThreadUtilisation
+        {
+            std::thread::id thread;
+            // Time in spans other than Scheduling, in Scheduling spans between two tiles and without any span
+            duration busy = duration::zero();
+            duration scheduling = duration::zero();
+            duration idle = duration::zero();
+            size_t   tiles = 0;
+            // Tiles, that directly followed another tile of the thread
+            size_t dequeues = 0;
+        };
+
+        // All times in milliseconds
+        struct Summary
+        {
+            size_t frames = 0;
+            double mean = 0;
+            double p50 = 0;
+            double p95 = 0;
+            double p99 = 0;
+            double max = 0;
+            // Busy time of all threads over the frame time of all threads, that had a span in a frame
+            double utilisation = 0;
+            // Average time between the end of a tile and the start of the next one on the same thread
+            double schedulingPerTile = 0;
+
+            std::vector<ThreadUtilisation> threads;
+        };
+
+        static constexpr size_t DefaultWindow = 256;
+
+    private:
+        struct Frame
+        {
+            duration                       time;
+            std::vector<ThreadUtilisation> threads;
+        };
+
+        std::deque<Frame> m_frames;
+        size_t            m_window;
+
+    public:
+        FrameReport(size_t window = DefaultWindow);
+
+        // The oldest frame is dropped once there are more than window frames
+        void    addFrame(const FrameProfile &profile);
+        void    clear();
+        Summary getSummary() const;
+    };
+
+    std::ostream &operator<<(std::ostream &stream, const FrameReport::Summary &summary);
+    void          writeJson(std::ostream &stream, const FrameReport::Summary &summary);
+
+    // Tasks are recorded as events into a ring buffer per thread, that only its thread writes without any lock.
+    // The events of a frame are merged into its FrameProfile by endFrame.
     class Profiler
     {
+        struct ThreadBuffer
+        {
+            // Events, that weren't merged within this many events of the thread, are overwritten
+            static constexpr size_t Capacity = 1 << 14;
+
+            // Start of a task, or the end of the current one if label is nullptr.
+            // Relaxed atomics, so merging may read a slot while it is written, that costs the same as plain stores.
+            struct Event
+            {
+                std::atomic<const char *> label;
+                std::atomic<int64_t>      time;
+                std::atomic<uint64_t>     allocations;
+            };
+
+            std::thread::id          thread;
+            std::unique_ptr<Event[]> events = std::make_unique<Event[]>(Capacity);
+            // Number of events written so far, the event i is in slot i % Capacity
+            std::atomic<uint64_t> head = 0;
+            // Head at the start of the current frame, guarded by profileMutex
+            uint64_t frameStart = 0;
+        };
+
         std::unique_ptr<FrameProfile> currentProfile;
         std::mutex                    profileMutex;
 
+        // Buffers of all threads, that ever recorded an event, guarded by profileMutex
+        std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+
+        inline static thread_local ThreadBuffer *t_buffer = nullptr;
+        inline static thread_local Profiler     *t_owner = nullptr;
+
+        size_t   cancelledFrames = 0;
+        duration cancelledTime = duration::zero();
+
+        // Fed with every finished frame, guarded by profileMutex
+        FrameReport report;
+
     public:
-        bool enabled = true;
+        std::atomic<bool> enabled = true;
+
+        // Called by endFrame with every merged frame, e.g. to write a trace. It must not call back into the profiler.
+        std::function<void(const FrameProfile &profile)> onFrame;
 
         inline FrameProfile          *getProfile() { return currentProfile.get(); }
         std::unique_ptr<FrameProfile> exchangeProfile();
 
+        FrameReport::Summary getReport();
+        void                 clearReport();
+
         void beginFrame();
-        void endFrame();
+        // Time of cancelled frames is added up and reported with the next finished frame
+        void endFrame(bool cancelled = false);
 
+        // Labels have to be string literals or outlive the profiles
         void profileTask(const char *Label);
         void endTask();
+        // Sets a counter of the current frame, the name has to outlive the profiles like labels
+        void setCounter(const char *name, double value);
+
+        // Records the given number of events on the calling thread outside of any frame, returns the time per event in nanoseconds
+        double measureOverhead(size_t events = 1 << 20);
+
+    private:
+        ThreadBuffer &registerThread();
+        void          record(const char *label);
+        void          mergeEvents(time_point end);
     };
 
     extern Profiler profiler;
@@ -63,6 +198,7 @@ namespace Profiling
 namespace rtImGui
 {
     void drawProfiler(const char *label, const Profiling::FrameProfile &profile, float height = 200);
+    void drawFrameReport(const Profiling::FrameReport::Summary &summary);
 } // namespace rtImGui
 
 #endif // PROFILER_HPP
\ No newline at end of file
@@ -0,0 +1,47 @@
+#ifndef RAY_PACKET_HPP
+#define RAY_PACKET_HPP
+
+#include <cstddef>
+
+#include <rtmath.h>
+
+namespace rt
+{
+    namespace m = math;
+
+    // Packets are stored as structure of arrays, so the per lane loops of the intersection kernels can be vectorized
+    static constexpr size_t MaxPacketSize = 16;
+
+    template <typename T>
+    struct BasicRayPacket
+    {
+        // Number of active lanes
+        size_t size = 0;
+
+        alignas(64) T originX[MaxPacketSize];
+        alignas(64) T originY[MaxPacketSize];
+        alignas(64) T originZ[MaxPacketSize];
+        alignas(64) T directionX[MaxPacketSize];
+        alignas(64) T directionY[MaxPacketSize];
+        alignas(64) T directionZ[MaxPacketSize];
+
+        inline m::ray<T> operator[](size_t i) const
+        {
+            return m::ray<T>(m::vec3<T>(originX[i], originY[i], originZ[i]), m::vec3<T>(directionX[i], directionY[i], directionZ[i]));
+        }
+
+        // Only works with matrices, that are not effecting the w component of a vector
+        void transform(const m::mat4<T> &matrix, BasicRayPacket<T> &result) const;
+
+        // Primary rays through the given pixel coordinates in the range [-1, 1], same as
+        // ray(vec3(coords, -1), vec3(0, 0, 1)).transformPerspective(inverseCamera) for every lane
+        void generateCameraRays(const T *coordsX, const T *coordsY, size_t size, const m::mat4<T> &inverseCamera);
+    };
+
+    extern template struct BasicRayPacket<float>;
+    extern template struct BasicRayPacket<double>;
+
+    using RayPacket = BasicRayPacket<double>;
+} // namespace rt
+
+#endif // RAY_PACKET_HPP
@@ -0,0 +1,70 @@
+#ifndef RAY_STATS_HPP
+#define RAY_STATS_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <ostream>
+
+namespace rt
+{
+    // Counts the work of the render path. Every thread counts into a RayStats of its own without atomics, see local(),
+    // the renderer adds up the difference of the counters of a thread over every tile into the statistics of the frame.
+    // It is padded to whole cache lines, so the counters of a thread never share a line with data of another thread.
+    struct alignas(64) RayStats
+    {
+        enum Counter
+        {
+            PrimaryRays,
+            ReflectionRays,
+            ShadowRays,
+            // Intersection tests of a ray with a single shape, per bucket of the compiled scene
+            PlaneTests,
+            SphereTests,
+            CubeTests,
+            VoxelTests,
+            GenericTests,
+            // Cells and skipped empty regions, that voxel rays stepped through
+            VoxelSteps,
+            TextureSamples,
+            Counter_COUNT,
+        };
+
+        // Propagation rays per recursion depth, primary rays have depth 0 and the last bucket holds all deeper rays
+        static constexpr size_t MaxDepth = 16;
+
+        std::array<uint64_t, Counter_COUNT> counters{};
+        std::array<uint64_t, MaxDepth>      depths{};
+
+        // Counters of the calling thread, they only ever grow
+        static inline RayStats &local();
+        static inline void      count(Counter counter, uint64_t n = 1) { local().counters[counter] += n; }
+        static inline void      countDepth(size_t depth) { local().depths[depth < MaxDepth ? depth : MaxDepth - 1]++; }
+
+        // Statistics of all frames of the process, that were traced to the end, and the time spent tracing them in milliseconds
+        static void     addToTotal(const RayStats &frame, double traceTime);
+        static uint64_t getTotal(RayStats &stats, double &traceTime);
+
+        inline uint64_t operator[](Counter counter) const { return counters[counter]; }
+        uint64_t        getRays() const;
+        uint64_t        getIntersectionTests() const;
+        // Millions of rays of all kinds per second of tracing, the number capacity is planned with
+        inline double getMraysPerSecond(double traceTime) const { return traceTime > 0 ? getRays() / traceTime / 1000 : 0; }
+
+        RayStats &operator+=(const RayStats &other);
+        RayStats  operator-(const RayStats &other) const;
+    };
+
+    inline thread_local RayStats t_rayStats;
+
+    inline RayStats &RayStats::local() { return t_rayStats; }
+
+    const char *rayCounterToString(RayStats::Counter counter);
+
+    std::ostream &operator<<(std::ostream &stream, const RayStats &stats);
+    // Summary of the statistics of the given frames, written as JSON for .json files and as CSV otherwise
+    void writeRayStatsSummary(const std::filesystem::path &path, const RayStats &stats, uint64_t frames, double traceTime);
+} // namespace rt
+
+#endif // RAY_STATS_HPP
@@ -0,0 +1,132 @@
+#ifndef RENDER_JOBS_HPP
+#define RENDER_JOBS_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+
+#include <frame_buffer.h>
+#include <renderer.h>
+#include <scene/scene.h>
+#include <work_stealing_pool.h>
+
+namespace rt
+{
+    namespace m = math;
+
+    class ResourceContainer;
+
+    // Renders final outputs in the background, one job at a time, the one with the highest priority first.
+    // Jobs run on a pool of their own, whose workers have background priority, so they only take a share of the cpus
+    // and preview frames on the render pool keep their latency.
+    class RenderJobQueue
+    {
+    public:
+        enum class JobState
+        {
+            Queued,
+            Running,
+            Finished,
+            Cancelled,
+            Failed,
+        };
+
+        struct Job
+        {
+            std::string name;
+            // Jobs with a higher priority are started first, jobs of the same priority in the order they were submitted
+            int priority = 0;
+            // Has to be detached from the scene of the previews, see Scene::snapshot
+            std::shared_ptr<const Scene> scene;
+            // Used by this job only, traceFrame calls of a renderer must not overlap
+            std::unique_ptr<Renderer> renderer;
+            RenderParams              renderParams;
+            m::u64vec2                size;
+            // Called on the thread of the queue with the finished image, not called for cancelled or failed jobs
+            std::function<void(const FrameBuffer &frameBuffer)> finished;
+            // Called after finished with the heatmap of renderParams.heatmap, if there is one, see Renderer::writeHeatmap
+            std::function<void(const FrameBuffer &heatmap)> heatmapFinished;
+            // Records the job as a frame of the profiler, only if no previews are rendered at the same time
+            bool profile = false;
+        };
+
+        struct JobStatus
+        {
+            uint64_t    id;
+            std::string name;
+            int         priority;
+            JobState    state;
+            // Fraction of the tiles, that were rendered
+            float progress = 0;
+            // Seconds since the job started and the estimated seconds until it finishes, extrapolated from the progress
+            double                elapsed = 0;
+            std::optional<double> remaining;
+            std::string           error;
+        };
+
+    private:
+        using clock = std::chrono::steady_clock;
+
+        struct Entry
+        {
+            uint64_t          id;
+            Job               job;
+            JobState          state = JobState::Queued;
+            clock::time_point start;
+            clock::time_point end;
+            std::string       error;
+            // Frame of the running job, to read its progress
+            const Renderer::FrameContext *frame = nullptr;
+            // Cancels the job once it differs from 0, see CancelToken
+            std::atomic<uint64_t> cancelled = 0;
+        };
+
+        WorkStealingPool<Renderer::task_type> *m_threadPool;
+        // Resources are not published while the scene of a job is compiled, see ResourceContainer::lockPublish
+        ResourceContainer *m_resources;
+
+        // Queued, running and finished jobs in the order they were submitted
+        std::list<Entry>        m_jobs;
+        uint64_t                m_nextId = 1;
+        bool                    m_terminate = false;
+        std::mutex              m_mutex;
+        std::condition_variable m_cv;
+
+        std::thread m_thread;
+
+    public:
+        RenderJobQueue(WorkStealingPool<Renderer::task_type> *threadPool, ResourceContainer *resources = nullptr);
+        ~RenderJobQueue();
+
+        RenderJobQueue(const RenderJobQueue &) = delete;
+        RenderJobQueue &operator=(const RenderJobQueue &) = delete;
+
+        // Returns the id of the job
+        uint64_t submit(Job job);
+        // Queued jobs are dropped, a running job stops after the tiles in progress
+        void cancel(uint64_t id);
+        // Forgets finished, cancelled and failed jobs
+        void clearDone();
+
+        std::vector<JobStatus>   getJobs();
+        std::optional<JobStatus> getJob(uint64_t id);
+        // Returns the status once the job is done or the timeout passed, whichever is first
+        JobStatus waitFor(uint64_t id, std::chrono::milliseconds timeout);
+
+    private:
+        JobStatus getStatus(const Entry &entry) const;
+        Entry    *findJob(uint64_t id);
+
+        void run();
+        void render(Entry &entry);
+    };
+
+    const char *jobStateToString(RenderJobQueue::JobState state);
+} // namespace rt
+
+#endif // RENDER_JOBS_HPP
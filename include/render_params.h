@@ -13,10 +13,38 @@ namespace rt
         m::u64vec2 tileSize;
         float      mixingFactor = 1.88f;
 
+        // Order in which tiles are handed out to the workers
+        enum TileOrder
+        {
+            RowMajor,
+            Morton,         // Z-order curve, neighbouring tiles are rendered close in time
+            Hilbert,        // Like Morton, but without jumps between distant tiles
+            Spiral,         // From the centre of the image outwards
+            CostDescending, // Most expensive tiles of the previous frame first, so no long tile is left for the end
+            TileOrder_COUNT,
+        } tileOrder = RowMajor;
+        // Tiles, that took much longer than the average tile in the previous frame, are split into four
+        bool splitExpensiveTiles = false;
+
         int recursionDepth = 3;
 
+        // Number of primary rays traced together, 1 disables packet tracing, otherwise 4, 8 or 16
+        size_t packetSize = 1;
+
         std::optional<m::u64vec2> logPixel;
 
+        // Cost of the tiles or pixels, that is recorded while tracing and drawn in false colour, see Renderer::writeHeatmap
+        enum Heatmap
+        {
+            NoHeatmap,
+            TileTime,    // Wall time of every tile per pixel
+            TileRays,    // Rays of every tile per pixel
+            PixelCycles, // CPU cycles of every pixel, tiles are rendered without packets to measure them
+            Heatmap_COUNT,
+        } heatmap = NoHeatmap;
+        // The heatmap is written to the frame buffer in place of the image
+        bool showHeatmap = true;
+
         // Tone mapping
         enum ToneMappingAlgorithm
         {
@@ -30,6 +58,38 @@ namespace rt
         float scale = 1.0f;
     };
 
+    inline const char *tileOrderToString(RenderParams::TileOrder order)
+    {
+        switch (order)
+        {
+        case RenderParams::Morton:
+            return "Morton";
+        case RenderParams::Hilbert:
+            return "Hilbert";
+        case RenderParams::Spiral:
+            return "Spiral";
+        case RenderParams::CostDescending:
+            return "Cost descending";
+        default:
+            return "Row major";
+        }
+    }
+
+    inline const char *heatmapToString(RenderParams::Heatmap heatmap)
+    {
+        switch (heatmap)
+        {
+        case RenderParams::TileTime:
+            return "Tile time";
+        case RenderParams::TileRays:
+            return "Tile rays";
+        case RenderParams::PixelCycles:
+            return "Pixel cycles";
+        default:
+            return "Off";
+        }
+    }
+
     inline const char *toneMappingAlgorithmToString(RenderParams::ToneMappingAlgorithm alg)
     {
         switch (alg)
@@ -5,16 +5,18 @@
 
 #include <event_stream.h>
 #include <frame_buffer.h>
+#include <frame_pipeline.h>
 #include <render_params.h>
 #include <renderer.h>
 #include <rtmath.h>
 #include <scene/scene.h>
-#include <thread_pool.h>
+#include <work_stealing_pool.h>
 
 namespace rt
 {
     namespace m = math;
 
+    // Renders the requested frames through a FramePipeline, so post-processing a frame overlaps with the next one
     class RenderThread : public std::thread
     {
     private:
@@ -27,28 +29,31 @@ namespace rt
         struct Event
         {
             EventType type;
-            union
-            {
-                struct
-                {
-                    Scene       *scene;
-                    FrameBuffer *frameBuffer;
-                };
-            };
+            // Number of the frame, a render event is skipped if a newer frame was requested in the meantime
+            uint64_t frame = 0;
+            bool     cancelable = true;
+
+            std::shared_ptr<const Scene> scene;
+            FrameBuffer                 *frameBuffer = nullptr;
+
             Event(EventType type);
-            Event(Scene &scene, FrameBuffer &frameBuffer);
+            Event(std::shared_ptr<const Scene> scene, FrameBuffer &frameBuffer, uint64_t frame, bool cancelable);
         };
 
     private:
         EventStream<Event> m_eventStream;
 
-        ThreadPool<Renderer::task_type> *m_threadPool;
+        WorkStealingPool<Renderer::task_type> *m_threadPool;
 
         Renderer *m_renderer;
 
         bool m_isRendering = false;
+        // Frames taken from the event stream, that were neither presented nor cancelled yet
+        size_t m_framesInFlight = 0;
+        bool   m_terminating = false;
 
-        RenderParams m_renderParams;
+        // Number of the latest requested frame, the running frame is cancelled once it changes
+        std::atomic<uint64_t> m_latestFrame = 0;
 
         std::mutex              m_renderFinished_mutex;
         std::condition_variable m_renderFinished_cv;
@@ -58,14 +63,21 @@ namespace rt
 
         std::string renderLog;
 
+        // Called on the render thread between frames, while none is prepared, e.g. to publish resources, that finished loading,
+        // see FramePipeline::frameBoundary
+        std::function<void()> frameBoundary;
+
     public:
-        RenderThread(ThreadPool<Renderer::task_type> *threadPool, Renderer *renderer = nullptr);
+        RenderThread(WorkStealingPool<Renderer::task_type> *threadPool, Renderer *renderer = nullptr);
         ~RenderThread();
 
         void terminate();
 
-        void startRender(Scene &scene, FrameBuffer &frameBuffer);
+        // The newest request wins: a cancelable frame, that is still rendering, is aborted and older requests are skipped.
+        // Takes a snapshot of the scene, so it has to be called on the thread editing it, the scene may be edited or destroyed right after.
+        void startRender(Scene &scene, FrameBuffer &frameBuffer, bool cancelable = true);
 
+        // Rendering lasts until all frames in flight were presented
         inline bool isRendering() const { return m_isRendering; }
         void        waitUntilFinished();
         void        waitUntilStarted();
@@ -75,6 +87,11 @@ namespace rt
 
     private:
         void run();
+
+        // Next frame for the pipeline, see FramePipeline::next
+        std::unique_ptr<Renderer::FrameContext> nextFrame(bool wait);
+        void                                    frameStarted();
+        void                                    frameDone();
     };
 } // namespace rt
 
@@ -1,45 +1,178 @@
 #ifndef RENDERER_HPP
 #define RENDERER_HPP
 
+#include <atomic>
 #include <frame_buffer.h>
 #include <future>
+#include <mutex>
+#include <ray_stats.h>
 #include <render_params.h>
 #include <rtmath.h>
 #include <scene/scene.h>
-#include <thread_pool.h>
+#include <work_stealing_pool.h>
 
 namespace rt
 {
     namespace m = math;
 
+    // A frame is cancelled as soon as a newer frame than the one it belongs to was requested
+    struct CancelToken
+    {
+        // Number of the latest requested frame, nullptr for frames that can't be cancelled
+        const std::atomic<uint64_t> *latestFrame = nullptr;
+        uint64_t                     frame = 0;
+
+        inline bool isCancelled() const { return latestFrame && latestFrame->load(std::memory_order_relaxed) != frame; }
+    };
+
     class Renderer
     {
     public:
         using task_type = std::packaged_task<void()>;
 
+        // Timing of the tiles of the last frame, all times in milliseconds
+        struct TileStats
+        {
+            size_t tileCount = 0;
+            // Tiles, that were split because they were expensive in the previous frame
+            size_t splitCount = 0;
+            // Workers of the pool and the thread calling doRender
+            size_t workerCount = 0;
+            // From handing out the first tile until the last one finished
+            double frameTime = 0;
+            // Time spent rendering tiles, summed over all workers
+            double busyTime = 0;
+            // Time the workers waited for the last tiles, workerCount * frameTime - busyTime
+            double idleTime = 0;
+        };
+
+        // Cost of a tile of a finished frame, for the heatmaps of tiles
+        struct TileCost
+        {
+            m::Rect<size_t> rect;
+            // Wall time in milliseconds
+            double   time;
+            uint64_t rays;
+        };
+
+        // Everything a frame is rendered with. Its stages only access the context and the compiled scenes of its slot,
+        // so the stages of consecutive frames can overlap, see FramePipeline.
+        struct FrameContext
+        {
+            Renderer                    *renderer = nullptr;
+            WorkStealingPool<task_type> *threadPool = nullptr;
+            // Snapshot of the scene, it stays alive until the frame was presented
+            std::shared_ptr<const Scene> scene;
+            // Written by postProcess, it is left untouched for cancelled frames
+            FrameBuffer *frameBuffer = nullptr;
+            // Copied, so the parameters can be changed while the frame is in flight
+            RenderParams renderParams;
+            CancelToken  cancelToken;
+            uint64_t     frame = 0;
+            // Compiled scenes of the scene, that are prepared for this frame, see Scene::FrameSlots
+            size_t slot = 0;
+            // The spans of traceFrame are only recorded into the profiler for profiled frames,
+            // so frames traced next to the profiled ones, e.g. unprofiled output jobs, don't end up in their profiles
+            bool profiled = true;
+
+            // Set by prepareFrame: the size of the frame buffer and the camera at that time
+            m::u64vec2 size = m::u64vec2(0);
+            m::dmat4   inverseCamera = m::dmat4(1);
+            // Color of every pixel before tone mapping, written by traceFrame.
+            // It is left uninitialized, so its pages are first touched by the workers rendering them and end up on their NUMA node.
+            std::unique_ptr<m::Color<float>[]> radiance;
+            // CPU cycles spent on every pixel, only allocated for the PixelCycles heatmap
+            std::unique_ptr<uint64_t[]> pixelCycles;
+            // Costs of all tiles, only recorded for the heatmaps of tiles, once the frame was traced to the end
+            std::vector<TileCost> tileCosts;
+
+            // Progress of traceFrame, may be read by other threads while the frame is traced
+            std::atomic<size_t> tileCount = 0;
+            std::atomic<size_t> tilesDone = 0;
+
+            // Counters of all tiles, that were rendered so far, see RayStats
+            RayStats   rayStats;
+            std::mutex rayStatsMutex;
+
+            inline m::Color<float> &at(const m::vec2<size_t> &coords) { return radiance[coords.y * size.x + coords.x]; }
+        };
+
     public:
-        ThreadPool<task_type> *threadPool;
+        // Members of the frame, that is currently traced, only valid during traceFrame
+        WorkStealingPool<task_type> *threadPool;
 
-        Scene *scene;
+        const Scene *scene;
 
         FrameBuffer *frameBuffer;
 
         RenderParams *renderParams;
 
+        CancelToken cancelToken;
+
+        FrameContext *frame;
+
+    private:
+        struct Tile
+        {
+            m::Rect<size_t> rect;
+            // Index of the tile in the grid of tileSize tiles, split tiles share it
+            uint32_t gridIndex;
+            // Tiles are handed out in ascending order of their key
+            double key;
+        };
+
+        // Kept between frames, so planning the tiles doesn't allocate once their count is stable
+        std::vector<Tile>     m_tiles;
+        std::vector<double>   m_tileTimes;
+        std::vector<uint64_t> m_tileRays;
+        // Time per grid tile of the previous frame, only valid while the grid has the same size
+        std::vector<double> m_gridCosts;
+        m::u64vec2          m_grid = m::u64vec2(0);
+
+        TileStats m_tileStats;
+        RayStats  m_rayStats;
+
     public:
         Renderer();
         virtual ~Renderer();
 
+        // New renderer of the same type, e.g. to trace frames concurrently with this one
+        virtual std::unique_ptr<Renderer> createInstance() const;
+
     protected:
         virtual void render();
         virtual void renderTile(const m::Rect<size_t> &tile);
         virtual void renderPixel(const m::vec2<size_t> &coords);
 
-        virtual void beginFrame();
-        virtual void endFrame();
+        // Checked between tiles and between rows of a tile, the rest of a cancelled frame is skipped
+        inline bool isCancelled() const { return cancelToken.isCancelled(); }
+
+    private:
+        void planTiles(const m::u64vec2 &size, const m::u64vec2 &grid);
+        void gatherTileStats(const m::u64vec2 &grid, double frameTime);
 
     public:
-        void doRender(ThreadPool<task_type> *threadPool, Scene *scene, FrameBuffer *frameBuffer, RenderParams *renderParams);
+        inline const TileStats &getTileStats() const { return m_tileStats; }
+        // Counters of the last frame, that was traced to the end
+        inline const RayStats &getRayStats() const { return m_rayStats; }
+        // Sets the counters of the last traced frame in the current frame of the profiler
+        void profileCounters(const FrameContext &frame) const;
+        // Draws the heatmap of renderParams.heatmap of a finished frame in false colour, from black over blue and red to yellow.
+        // Returns the cost, that maps to the hottest colour, in the unit of the heatmap.
+        static double writeHeatmap(const FrameContext &frame, FrameBuffer &frameBuffer);
+
+        // Stages of a frame. prepareFrame and postProcess only use the given frame,
+        // they may run concurrently with traceFrame of another frame. Calls of traceFrame must not overlap.
+        // Caches the frame data of the scene and builds the compiled scene of the slot of the frame
+        virtual void prepareFrame(FrameContext &frame);
+        // Renders the tiles into the radiance of the frame, returns false if the frame was cancelled
+        bool traceFrame(FrameContext &frame);
+        // Writes the radiance of a finished frame to its frame buffer
+        virtual void postProcess(FrameContext &frame);
+
+        // Runs all stages of a single frame in sequence.
+        // Returns false if the frame was cancelled, the frame buffer is left untouched then.
+        bool doRender(WorkStealingPool<task_type> *threadPool, std::shared_ptr<const Scene> scene, FrameBuffer *frameBuffer, RenderParams *renderParams, CancelToken cancelToken = {});
     };
 } // namespace rt
 
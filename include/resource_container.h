@@ -8,11 +8,12 @@
 #include <mutex>
 #include <optional>
 #include <set>
+#include <shared_mutex>
 #include <string>
 #include <typeindex>
 #include <vector>
 
-#include <thread_pool.h>
+#include <work_stealing_pool.h>
 
 namespace rt
 {
@@ -57,6 +58,9 @@ namespace rt
         virtual ~Resource() = default;
     };
 
+    // Loader specific options of a resource, e.g. given in the scene file
+    using ResourceParameters = std::map<std::string, std::string>;
+
     class ResourceLoader
     {
     private:
@@ -64,7 +68,7 @@ namespace rt
         ResourceLoader() = default;
         virtual ~ResourceLoader() = default;
 
-        virtual void load(ResourceRef<void> resource, const std::filesystem::path &path) const = 0;
+        virtual void load(ResourceRef<void> resource, const std::filesystem::path &path, const ResourceParameters &parameters) const = 0;
     };
 
     struct _SharedResourceState : public std::enable_shared_from_this<_SharedResourceState>
@@ -73,11 +77,14 @@ namespace rt
         {
             NotLoaded,
             Loading,
+            // Decoded by the loader, but not published to the renderer yet, see ResourceContainer::publish
+            Decoded,
             Loaded,
             Failed,
         } state;
 
         std::filesystem::path     path;
+        ResourceParameters        parameters;
         std::type_index           type;
         std::unique_ptr<Resource> ptr;
         std::exception_ptr        exception;
@@ -86,8 +93,8 @@ namespace rt
         std::set<std::type_index> failedTypes;
 
     private:
-        _SharedResourceState(const std::filesystem::path &path, ResourceContainer *container)
-            : state(State::NotLoaded), path(path), type(typeid(void)), ptr(nullptr), exception(nullptr), container(container) {}
+        _SharedResourceState(const std::filesystem::path &path, const ResourceParameters &parameters, ResourceContainer *container)
+            : state(State::NotLoaded), path(path), parameters(parameters), type(typeid(void)), ptr(nullptr), exception(nullptr), container(container) {}
 
         friend class ResourceContainer;
     };
@@ -115,11 +122,12 @@ namespace rt
         inline bool resourceAttached() const { return m_ptr.operator bool(); }
         inline T   *operator->() { return (T *)m_ptr->ptr.get(); };
         inline T   *operator->() const { return (T *)m_ptr->ptr.get(); }
-        inline T   &operator*() { return *(m_ptr->ptr); };
-        inline T   &operator*() const { return *(m_ptr->ptr); }
+        inline T   &operator*() { return *(T *)m_ptr->ptr.get(); };
+        inline T   &operator*() const { return *(T *)m_ptr->ptr.get(); }
 
         inline const bool                   hasException() const { return m_ptr->state == _SharedResourceState::State::Failed; }
         inline const std::filesystem::path &getPath() const { return m_ptr->path; }
+        inline const ResourceParameters    &getParameters() const { return m_ptr->parameters; }
         inline const std::exception_ptr     getException() const { return m_ptr->exception; }
         inline const std::type_index        getType() const { return m_ptr->type; }
     };
@@ -151,6 +159,7 @@ namespace rt
 
         inline const bool                   hasException() const { return (m_ptr->state == _SharedResourceState::State::Failed); }
         inline const std::filesystem::path &getPath() const { return m_ptr->path; }
+        inline const ResourceParameters    &getParameters() const { return m_ptr->parameters; }
         inline const std::exception_ptr     getException() const { return m_ptr->exception; }
         inline const std::type_index        getType() const { return m_ptr->type; }
         inline const void                  *getPtr() const { return m_ptr.get(); }
@@ -189,12 +198,18 @@ namespace rt
 
         std::map<std::type_index, std::unique_ptr<ResourceLoader>> m_loaders;
 
-        ThreadPool<std::packaged_task<void()>> *m_threadPool;
+        WorkStealingPool<std::packaged_task<void()>> *m_threadPool;
 
         std::filesystem::path m_appDir;
 
         std::vector<std::future<void>> m_loadingFutures;
 
+        // Resources, that were decoded since the last publish
+        std::vector<std::shared_ptr<_SharedResourceState>> m_decoded;
+        std::mutex                                         m_decodedMutex;
+        // Held shared while frames outside of the render thread are prepared, publish skips while it is held
+        std::shared_mutex m_publishMutex;
+
     private:
         template <class T>
         class _Iterator
@@ -240,15 +255,19 @@ namespace rt
         using ReverseIterator = _Iterator<resource_collection_type::reverse_iterator>;
 
     public:
-        ResourceContainer(ThreadPool<std::packaged_task<void()>> *threadPool, const std::filesystem::path &m_appDir)
+        // Resources are decoded on threadPool, it should be a pool of its own, so decoding doesn't compete with rendering
+        ResourceContainer(WorkStealingPool<std::packaged_task<void()>> *threadPool, const std::filesystem::path &m_appDir)
             : m_threadPool(threadPool), m_appDir(m_appDir) {}
         ~ResourceContainer()
         {
+            m_decoded.clear();
             assert(std::all_of(m_resources.begin(), m_resources.end(), [](std::shared_ptr<_SharedResourceState> &r)
                                { return r.use_count() == 1; }));
         }
 
         ResourceRef<void> operator+=(const std::filesystem::path &path);
+        // Resources with the same path but different parameters are loaded separately
+        ResourceRef<void> get(const std::filesystem::path &path, const ResourceParameters &parameters = {});
 
         // This function takes ownership of loader
         template <class Type, class T,
@@ -261,11 +280,24 @@ namespace rt
         inline ReverseIterator rbegin() { return _Iterator(m_resources.rbegin()); }
         inline ReverseIterator rend() { return _Iterator(m_resources.rend()); }
 
+        // Waits for all requested resources and publishes them
         void waitForFinishLoading();
+        // Makes the resources decoded since the last call visible, they are not loaded before.
+        // Called at frame boundaries, so a resource never appears in the middle of a frame.
+        // Does nothing while a frame holds lockPublish, the resources are published by a later call then.
+        void publish();
+        // Keeps publish from changing the state of resources until the lock is released, for frames that are prepared
+        // concurrently with the frame boundaries of the render thread, see RenderJobQueue. Hold it only briefly,
+        // previews don't publish anything meanwhile.
+        inline std::shared_lock<std::shared_mutex> lockPublish() { return std::shared_lock(m_publishMutex); }
 
     private:
+        void submitDecoded(const std::shared_ptr<_SharedResourceState> &state);
+        // Expects m_publishMutex to be held exclusively
+        void publishDecoded();
+
         void requestLoad(_SharedResourceState &state, std::type_index type);
-        void loadTask(ResourceLoader *loader, std::filesystem::path path, const ResourceRef<void> &resource);
+        void loadTask(ResourceLoader *loader, std::filesystem::path path, ResourceParameters parameters, const ResourceRef<void> &resource);
 
         template <class T>
         friend class ResourceRef;
@@ -295,8 +327,8 @@ namespace rt
         if (!ptr)
             return;
         assert(ptr->type == typeid(T) && "Resource loader returned resource of wrong type");
-        ptr->state = _SharedResourceState::State::Loaded;
         ptr->ptr = std::move(resource);
+        ptr->container->submitDecoded(ptr);
     }
 
     template <class T>
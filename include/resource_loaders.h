@@ -10,14 +10,24 @@ namespace rt
     {
         class VoxelGridLoader : public ResourceLoader
         {
+        private:
+            WorkStealingPool<std::packaged_task<void()>> *m_threadPool;
+
         public:
-            virtual void load(ResourceRef<void> resource, const std::filesystem::path &path) const override;
+            // The thread pool is used to compute distance fields
+            VoxelGridLoader(WorkStealingPool<std::packaged_task<void()>> *threadPool)
+                : m_threadPool(threadPool) {}
+
+            virtual void load(ResourceRef<void> resource, const std::filesystem::path &path, const ResourceParameters &parameters) const override;
+
+        private:
+            void computeDistanceField(Resources::VoxelGridResource &resource) const;
         };
 
         class TextureLoader : public ResourceLoader
         {
         public:
-            virtual void load(ResourceRef<void> resource, const std::filesystem::path &path) const override;
+            virtual void load(ResourceRef<void> resource, const std::filesystem::path &path, const ResourceParameters &parameters) const override;
         };
     } // namespace ResourceLoaders
 } // namespace rt
@@ -12,14 +12,39 @@ namespace rt
         class VoxelGridResource : public Resource
         {
         public:
+            // How empty space is skipped when casting rays through the grid,
+            // selected with the "acceleration" parameter of the resource
+            enum class Acceleration
+            {
+                Dense,         // Step through every cell
+                BrickMap,      // Skip empty bricks of the sparse grid
+                DistanceField, // Leap over the empty cells around every cell
+            };
+
+            // Distances are capped, larger leaps are rare and make the field more expensive to compute
+            static constexpr uint8_t MaxDistance = 16;
+
             VoxelGrid    grid;
             ColorPalette colorPalette;
 
+            Acceleration acceleration = Acceleration::BrickMap;
+            // Chebyshev distance from every cell to the nearest filled voxel in cells, 0 for filled voxels
+            std::vector<uint8_t> distanceField;
+            // Bounds of the filled voxels in local object space, where the grid is mapped onto the unit cube.
+            // Shared by all shapes using this grid, std::nullopt if no voxel is filled.
+            std::optional<m::AABB<double>> occupiedBounds;
+
         public:
             VoxelGridResource(const VoxelGrid &grid, const ColorPalette &colorPalette) : grid(grid), colorPalette(colorPalette) {}
             VoxelGridResource(const VoxelGrid &grid) : grid(grid) {}
             VoxelGridResource(VoxelGrid &&grid, const ColorPalette &colorPalette) : grid(std::move(grid)), colorPalette(colorPalette) {}
             VoxelGridResource(VoxelGrid &&grid) : grid(std::move(grid)) {}
+
+            inline uint8_t distanceAt(const m::u64vec3 &position) const
+            {
+                auto size = grid.getSize();
+                return distanceField[position.x + position.y * size.x + position.z * size.x * size.y];
+            }
         };
 
         class TextureResource : public Resource
@@ -7,17 +7,42 @@ namespace rt
 {
     namespace m = math;
 
+    // Interface of the ray tracers used by materials, independent of the precision rays are traced with
     class RTRenderer : public Renderer
     {
     public:
-        void beginFrame() override;
+        virtual m::Color<float>                castPropagationRay(const m::ray<double> &ray, int recursion = 5) const = 0;
+        virtual std::optional<m::Color<float>> castLightRay(const m::dvec3 position, const SceneLight &light) const = 0;
+    };
+
+    // Traces rays and intersects the compiled scene with the scalar type T.
+    // float doubles the SIMD width of the intersection kernels, double is kept for scenes with large coordinates.
+    // Intersections and shading are always in double precision.
+    template <typename T>
+    class BasicRTRenderer : public RTRenderer
+    {
+    public:
+        std::unique_ptr<Renderer> createInstance() const override;
 
+        void prepareFrame(FrameContext &frame) override;
+        // Tone maps the radiance into the frame buffer
+        void postProcess(FrameContext &frame) override;
+
+        // Traces packets of primary rays, if enabled in the render params
+        void renderTile(const m::Rect<size_t> &tile) override;
         void renderPixel(const m::vec2<size_t> &coords) override;
 
-        m::Color<float>                castPropagationRay(const m::ray<double> &ray, int recursion = 5) const;
-        std::optional<m::Color<float>> castLightRay(const m::dvec3 position, const SceneLight &light) const;
+        m::Color<float>                castPropagationRay(const m::ray<double> &ray, int recursion = 5) const override;
+        std::optional<m::Color<float>> castLightRay(const m::dvec3 position, const SceneLight &light) const override;
+
+    private:
+        m::Color<float> trace(const m::ray<T> &ray, int recursion) const;
+        m::Color<float> shade(const m::ray<double> &ray, const std::optional<Intersection> &maybeIntersection, int recursion) const;
     };
 
+    extern template class BasicRTRenderer<float>;
+    extern template class BasicRTRenderer<double>;
+
 } // namespace rt
 
-#endif // RT_RENDERER_HPP
\ No newline at end of file
+#endif // RT_RENDERER_HPP
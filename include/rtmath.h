@@ -4,6 +4,7 @@
 #include <algorithm>
 #include <iomanip>
 #include <iostream>
+#include <limits>
 
 #define GLM_FORCE_SWIZZLE
 #include <glm/glm.hpp>
@@ -56,6 +57,9 @@ namespace rt
             vec3<T> direction;
 
             ray(vec3<T> origin = vec3<T>(), vec3<T> direction = vec3<T>()) : origin(origin), direction(direction) {}
+            // Converts between scalar types, e.g. to intersect a float ray with double precision shapes
+            template <typename U>
+            explicit ray(const ray<U> &other) : origin(other.origin), direction(other.direction) {}
 
             ray<T> transformPerspective(const mat4<T> &matrix) const
             {
@@ -187,6 +191,7 @@ namespace rt
             Rect() : start(), size() {}
 
             inline vec2<T> getEnd() const { return start + size; }
+            inline bool    contains(vec2<T> point) const { return point.x >= start.x && point.y >= start.y && point.x < start.x + size.x && point.y < start.y + size.y; }
 
             Rect<T>        min(T _x, T _y) const { return Rect(math::min<T>(start, _x, _y), math::min<T>(getEnd(), _x, _y) - start); }
             Rect<T>        max(T _x, T _y) const { return Rect(math::max<T>(start, _x, _y), math::max<T>(getEnd(), _x, _y) - start); }
@@ -201,6 +206,71 @@ namespace rt
             return stream;
         }
 
+        // Axis aligned bounding box, a default constructed box is empty
+        template <typename T>
+        struct AABB
+        {
+            vec3<T> min;
+            vec3<T> max;
+
+            AABB(vec3<T> min, vec3<T> max) : min(min), max(max) {}
+            AABB() : min(std::numeric_limits<T>::infinity()), max(-std::numeric_limits<T>::infinity()) {}
+
+            inline bool    isEmpty() const { return min.x > max.x || min.y > max.y || min.z > max.z; }
+            inline vec3<T> getCenter() const { return (min + max) * T(0.5); }
+            inline vec3<T> getExtent() const { return max - min; }
+            inline T       getSurfaceArea() const
+            {
+                auto e = getExtent();
+                return 2 * (e.x * e.y + e.y * e.z + e.z * e.x);
+            }
+
+            inline AABB<T> &grow(const vec3<T> &point)
+            {
+                min = glm::min(min, point);
+                max = glm::max(max, point);
+                return *this;
+            }
+            inline AABB<T> &grow(const AABB<T> &other)
+            {
+                min = glm::min(min, other.min);
+                max = glm::max(max, other.max);
+                return *this;
+            }
+
+            // Bounds of this box after applying an affine matrix to it
+            AABB<T> transform(const mat4<T> &matrix) const
+            {
+                vec3<T> translation(matrix[3]);
+                AABB<T> result(translation, translation);
+                for (int i = 0; i < 3; i++)
+                    for (int j = 0; j < 3; j++)
+                    {
+                        T a = matrix[i][j] * min[i];
+                        T b = matrix[i][j] * max[i];
+                        result.min[j] += std::min(a, b);
+                        result.max[j] += std::max(a, b);
+                    }
+                return result;
+            }
+
+            // Slab test, invDirection is 1 / ray.direction.
+            // On success, tEntry is the ray parameter where the ray enters the box, clamped to 0.
+            inline bool intersect(const ray<T> &ray, const vec3<T> &invDirection, T tMax, T *tEntry) const
+            {
+                vec3<T> t0 = (min - ray.origin) * invDirection;
+                vec3<T> t1 = (max - ray.origin) * invDirection;
+                vec3<T> tNear = glm::min(t0, t1);
+                vec3<T> tFar = glm::max(t0, t1);
+
+                T tn = std::max({tNear.x, tNear.y, tNear.z, T(0)});
+                T tf = std::min({tFar.x, tFar.y, tFar.z, tMax});
+
+                *tEntry = tn;
+                return tn <= tf;
+            }
+        };
+
 #pragma warning(push)
 #pragma warning(disable : 4244)
         template <typename T, typename D>
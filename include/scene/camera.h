@@ -23,6 +23,8 @@ namespace rt
         Camera(const std::string_view &name, const Transform &transform = Transform(), float FOV = glm::radians(80.0), double zNear = 0.01, double zFar = 2);
         Camera(const Transform &transform = Transform(), float FOV = glm::radians(80.0), double zNear = 0.01, double zFar = 2);
 
+        virtual Camera *clone() const override { return new Camera(*this); }
+
         virtual std::ostream &toString(std::ostream &stream) const override;
 
         virtual bool onInspectorGUI() override;
@@ -17,6 +17,8 @@ namespace rt
     public:
         Material(const std::string_view &name);
 
+        virtual Material *clone() const override = 0;
+
         virtual m::Color<float> render(const m::dvec3   &position,
                                        const m::dvec3   &normal,
                                        const m::dvec3   &hitDirection,
@@ -51,6 +53,8 @@ namespace rt
                         float        specular = 1.0f,
                         float        reflection = 0.1f);
 
+            virtual LitMaterial *clone() const override { return new LitMaterial(*this); }
+
             virtual m::Color<float> render(const m::dvec3   &position,
                                            const m::dvec3   &normal,
                                            const m::dvec3   &hitDirection,
@@ -38,6 +38,8 @@ namespace rt
         Sampler(const std::string_view &name) : SceneObject(name) {}
         virtual ~Sampler() = default;
 
+        virtual Sampler *clone() const override = 0;
+
         m::Color<float> sample(const SampleInfo &info) const;
 
         virtual m::Color<float> sampleUV(const m::fvec2 &uv) const { return m::Color<float>(1, 0, 1); }
@@ -58,6 +60,8 @@ namespace rt
             ColorSampler(const std::string_view &name, const m::Color<float> &color = m::Color<float>(0.9f, 0.9f, 0.9f))
                 : color(color), Sampler(name) {}
 
+            virtual ColorSampler *clone() const override { return new ColorSampler(*this); }
+
             virtual m::Color<float> sampleUV(const m::fvec2 &uv) const override { return color; }
             virtual m::Color<float> sampleDirection(const m::fvec3 &direction) const override { return color; }
             virtual m::Color<float> sampleIndex(size_t index) const override { return color; }
@@ -109,8 +113,12 @@ namespace rt
             TextureSampler(const std::string_view &name, const ResourceRef<Resources::TextureResource> &texture)
                 : texture(texture), Sampler(name) {}
 
+            virtual TextureSampler *clone() const override { return new TextureSampler(*this); }
+
         protected:
             m::Color<float> samplePoint(m::ivec2 texCoords, const m::uvec2 &size) const;
+            // Body of the bilinear filter kernel, that is compiled per instruction set, see RT_KERNEL
+            friend m::Color<float> bilinearFilterBody(const TextureSampler &sampler, m::fvec2 texPos, const m::uvec2 &size);
 
             virtual m::Color<float> sampleUV(const m::fvec2 &uv) const override;
             virtual m::Color<float> sampleDirection(const m::fvec3 &direction) const override;
@@ -132,6 +140,8 @@ namespace rt
             PaletteSampler(const std::string_view &name, ResourceRef<Resources::VoxelGridResource> palette)
                 : palette(palette), Sampler(name) {}
 
+            virtual PaletteSampler *clone() const override { return new PaletteSampler(*this); }
+
             virtual m::Color<float> sampleIndex(size_t index) const override { return palette ? palette->colorPalette[(unsigned)index] : invalidColor; }
 
             virtual bool onInspectorGUI() override;
@@ -156,6 +166,12 @@ namespace rt
         template <class F>
         SamplerRef(std::unique_ptr<F> &&ptr)
             : m_ptr(static_cast<T *>(ptr.release())) {}
+        // Copies clone the sampler
+        SamplerRef(const SamplerRef &other) : m_ptr(other ? static_cast<T *>(other->clone()) : nullptr) {}
+        SamplerRef(SamplerRef &&other) = default;
+
+        inline SamplerRef &operator=(const SamplerRef &other) { return *this = SamplerRef(other); }
+        SamplerRef        &operator=(SamplerRef &&other) = default;
 
         inline          operator bool() const { return m_ptr.operator bool(); }
         inline T       *operator->() { return m_ptr.get(); }
@@ -181,6 +197,12 @@ namespace rt
         template <class F>
         SamplerRef(std::unique_ptr<F> &&ptr)
             : m_ptr(static_cast<Sampler *>(ptr.release())) {}
+        // Copies clone the sampler
+        SamplerRef(const SamplerRef &other) : m_ptr(other ? other->clone() : nullptr) {}
+        SamplerRef(SamplerRef &&other) = default;
+
+        inline SamplerRef &operator=(const SamplerRef &other) { return *this = SamplerRef(other); }
+        SamplerRef        &operator=(SamplerRef &&other) = default;
 
         inline                operator bool() const { return m_ptr.operator bool(); }
         inline Sampler       *operator->() { return m_ptr.get(); }
@@ -1,23 +1,32 @@
 #ifndef SCENE_HPP
 #define SCENE_HPP
 
+#include <compiled_scene.h>
 #include <scene/camera.h>
 #include <scene/material.h>
 #include <scene/scene_lights.h>
 #include <scene/scene_shapes.h>
 
+#include <array>
 #include <map>
 #include <memory>
+#include <tuple>
 #include <vector>
 
 namespace rt
 {
+    // The scene edited by the GUI is never rendered directly. Every frame renders an immutable snapshot of it instead,
+    // so editing never races with or waits for rendering. Objects are shared, so snapshots only copy what changed.
     class Scene
     {
     public:
-        using shape_collection_type = std::vector<std::unique_ptr<SceneShape>>;
-        using light_collection_type = std::vector<std::unique_ptr<SceneLight>>;
-        using material_collection_type = std::map<size_t, std::unique_ptr<Material>>;
+        // Compiled scenes per scalar type. Consecutive frames use different slots,
+        // so the next frame can be prepared while the current one is still traced.
+        static constexpr size_t FrameSlots = 2;
+
+        using shape_collection_type = std::vector<std::shared_ptr<SceneShape>>;
+        using light_collection_type = std::vector<std::shared_ptr<SceneLight>>;
+        using material_collection_type = std::map<size_t, std::shared_ptr<Material>>;
 
     public:
         shape_collection_type objects;
@@ -30,6 +39,30 @@ namespace rt
 
         SamplerRef<> environmentTexture;
 
+    private:
+        using compiled_type = std::tuple<std::array<BasicCompiledScene<float>, FrameSlots>, std::array<BasicCompiledScene<double>, FrameSlots>>;
+
+    public:
+        // Copy of an object in the last snapshot, with the object and revision it was taken from
+        struct SnapshotCopy
+        {
+            const SceneObject           *source;
+            uint64_t                     revision;
+            std::shared_ptr<SceneObject> copy;
+        };
+
+    private:
+        // Render ready shapes and their acceleration structures per scalar type and slot, updated every frame by buildAccelerationStructure.
+        // Every slot keeps its own revisions, so it is refit from whatever state it was left in.
+        // Shared by a scene and all its snapshots, so the structures are refit across frames.
+        std::shared_ptr<compiled_type> m_compiled = std::make_shared<compiled_type>();
+        // Incremented whenever shapes are added or removed
+        uint64_t m_structureRevision = 0;
+
+        // Copies of the last snapshot in the order shapes, lights, materials
+        std::vector<SnapshotCopy> m_snapshotCopies;
+        uint64_t                  m_snapshotStructureRevision = UINT64_MAX;
+
     public:
         Scene(shape_collection_type &objects, const Camera &camera = Camera());
         Scene(shape_collection_type &&objects = shape_collection_type(), const Camera &camera = Camera());
@@ -42,9 +75,41 @@ namespace rt
 
         Material *getMaterial(size_t index) const;
 
-        void cacheFrameData(const m::u64vec2 &screenSize) const;
+        // Has to be called after shapes were added to or removed from objects directly
+        inline void markStructureChanged() { m_structureRevision++; }
+
+        // Immutable copy of everything a frame is rendered from, taken on the thread editing the scene.
+        // Objects, that didn't change since the last snapshot, are shared with it instead of copied.
+        std::shared_ptr<const Scene> snapshot();
+        // Copy, that shares neither objects nor compiled scenes with this scene and its snapshots,
+        // so it can be rendered concurrently with them, e.g. by a render job
+        std::shared_ptr<const Scene> detachedSnapshot() const;
 
-        std::optional<Intersection> castRay(const m::ray<double> &ray, std::optional<double> maxLength2 = std::nullopt) const;
+        // Only the matrices of transforms, that were marked as changed, are recomputed
+        void cacheFrameData(const m::u64vec2 &screenSize) const;
+        // Requires the frame data to be cached. Only the compiled scene of the scalar type T and the given slot is updated,
+        // the queries below have to use the same T and slot until the next build of that slot.
+        // Changed shapes are refit into the existing acceleration structures, it is only rebuilt after structural changes.
+        // The queries never read the shapes transforms, so the frame data can be cached again while another slot is queried.
+        template <typename T = double>
+        void buildAccelerationStructure(size_t slot = 0) const;
+
+        // Rays are traced with the scalar type T, intersections are always returned in double precision
+        template <typename T>
+        std::optional<Intersection> castRay(const m::ray<T> &ray, std::optional<double> maxLength2 = std::nullopt, size_t slot = 0) const;
+        // Returns true as soon as any shape is hit, cheaper than castRay for shadow rays
+        template <typename T>
+        bool occluded(const m::ray<T> &ray, std::optional<double> maxLength2 = std::nullopt, size_t slot = 0) const;
+
+        // Finds the nearest hit of every lane, hits have to be initialized with the maximum ray parameters
+        template <typename T>
+        void castPacket(const BasicRayPacket<T> &packet, BasicPacketHits<T> &hits, size_t slot = 0) const;
+        // Full intersection of lane i in world space, after castPacket
+        template <typename T>
+        std::optional<Intersection> resolvePacketHit(const BasicRayPacket<T> &packet, const BasicPacketHits<T> &hits, size_t i, size_t slot = 0) const;
+
+        template <typename T = double>
+        inline const BasicCompiledScene<T> &getCompiled(size_t slot = 0) const { return std::get<std::array<BasicCompiledScene<T>, FrameSlots>>(*m_compiled)[slot]; }
 
         bool onInspectorGUI();
 
@@ -17,6 +17,8 @@ namespace rt
         SceneLight(const std::string_view &name, float intensity);
         virtual ~SceneLight() = default;
 
+        virtual SceneLight *clone() const override = 0;
+
         virtual std::optional<m::dvec3> getLightDirection(const m::dvec3 &position) const = 0;
         virtual std::optional<double>   getMaxDistance() const;
         virtual m::Color<float>         getColor(const m::dvec3 &position) const = 0;
@@ -32,6 +34,8 @@ namespace rt
             PointLight(const std::string_view &name, m::dvec3 position = m::dvec3(0), m::Color<float> color = m::Color<float>(0.9f), float intensity = 1);
             PointLight(m::dvec3 position = m::dvec3(0), m::Color<float> color = m::Color<float>(0.9f), float intensity = 1);
 
+            virtual PointLight *clone() const override { return new PointLight(*this); }
+
             virtual std::optional<m::dvec3> getLightDirection(const m::dvec3 &position) const override;
             virtual m::Color<float>         getColor(const m::dvec3 &position) const override;
 
@@ -48,6 +52,8 @@ namespace rt
             DirectionalLight(const std::string_view &name, m::dvec3 direction = m::dvec3(0, 1, 0), m::Color<float> color = m::Color<float>(0.9f), float intensity = 1);
             DirectionalLight(m::dvec3 direction = m::dvec3(0, 1, 0), m::Color<float> color = m::Color<float>(0.9f), float intensity = 1);
 
+            virtual DirectionalLight *clone() const override { return new DirectionalLight(*this); }
+
             virtual std::optional<m::dvec3> getLightDirection(const m::dvec3 &position) const override;
             virtual m::Color<float>         getColor(const m::dvec3 &position) const override;
 
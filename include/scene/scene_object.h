@@ -1,6 +1,7 @@
 #ifndef SCENE_OBJECT_HPP
 #define SCENE_OBJECT_HPP
 
+#include <cstdint>
 #include <string>
 
 namespace rt
@@ -10,9 +11,20 @@ namespace rt
     public:
         std::string name;
 
+    private:
+        uint64_t m_revision = 0;
+
+    public:
         SceneObject(const std::string_view &name);
         virtual ~SceneObject() = default;
 
+        // Deep copy, scene snapshots hold copies of the objects
+        virtual SceneObject *clone() const = 0;
+
+        // Has to be called after a property of the object was edited, snapshots only copy objects whose revision changed
+        inline void             markChanged() { m_revision++; }
+        virtual inline uint64_t getRevision() const { return m_revision; }
+
         virtual bool onInspectorGUI();
 
         virtual std::ostream &toString(std::ostream &stream) const = 0;
@@ -15,8 +15,10 @@ namespace rt
 
     struct Intersection
     {
-        m::dvec3    position;
-        m::dvec3    normal;
+        m::dvec3 position;
+        m::dvec3 normal;
+        // Ray parameter of the hit, it is the same in local and world space, because object transforms are affine
+        double      t;
         SceneShape *object;
         SampleInfo  sampleInfo;
     };
@@ -27,12 +29,25 @@ namespace rt
         Transform transform;
         size_t    materialIndex;
 
-    private:
     public:
         SceneShape(const std::string_view &name, const Transform &transform = Transform(), size_t materialIndex = 0);
         virtual ~SceneShape() = default;
 
+        virtual SceneShape *clone() const override = 0;
+
+        // Changes of the transform only have to be marked on the transform.
+        // Changes whenever the shape or its transform changed, both counters only grow so their sum does too.
+        inline uint64_t getRevision() const override { return SceneObject::getRevision() + transform.getRevision(); }
+
         virtual std::optional<Intersection> intersect(const m::ray<double> &ray) const = 0;
+        // Whether the ray hits the shape before tMax, ray is in local object space.
+        // Used for shadow rays, so implementations should avoid building an Intersection.
+        virtual bool occludes(const m::ray<double> &ray, double tMax) const;
+
+        // Bounds in local object space, std::nullopt for shapes without finite bounds
+        virtual std::optional<m::AABB<double>> getLocalBounds() const;
+        // Bounds in world space, requires the cached transform matrices to be up to date
+        std::optional<m::AABB<double>> getBounds() const;
 
         virtual bool onInspectorGUI() override;
     };
@@ -46,7 +61,12 @@ namespace rt
             Sphere(const std::string_view &name, double radius = 1, const Transform &transform = Transform(), size_t materialIndex = 0);
             Sphere(double radius = 1, const Transform &transform = Transform(), size_t materialIndex = 0);
 
+            virtual Sphere *clone() const override { return new Sphere(*this); }
+
             virtual std::optional<Intersection> intersect(const m::ray<double> &ray) const override;
+            virtual bool                        occludes(const m::ray<double> &ray, double tMax) const override;
+
+            virtual std::optional<m::AABB<double>> getLocalBounds() const override;
 
             virtual bool onInspectorGUI() override;
 
@@ -58,7 +78,10 @@ namespace rt
             Plane(const std::string_view &name, const Transform &transform = Transform(), size_t materialIndex = 0);
             Plane(const Transform &transform = Transform(), size_t materialIndex = 0);
 
+            virtual Plane *clone() const override { return new Plane(*this); }
+
             virtual std::optional<Intersection> intersect(const m::ray<double> &ray) const override;
+            virtual bool                        occludes(const m::ray<double> &ray, double tMax) const override;
 
             virtual std::ostream &toString(std::ostream &stream) const override;
         };
@@ -68,7 +91,12 @@ namespace rt
             Cube(const std::string_view &name, const Transform &transform = Transform(), size_t materialIndex = 0);
             Cube(const Transform &transform = Transform(), size_t materialIndex = 0);
 
+            virtual Cube *clone() const override { return new Cube(*this); }
+
             virtual std::optional<Intersection> intersect(const m::ray<double> &ray) const override;
+            virtual bool                        occludes(const m::ray<double> &ray, double tMax) const override;
+
+            virtual std::optional<m::AABB<double>> getLocalBounds() const override;
 
             virtual std::ostream &toString(std::ostream &stream) const override;
         };
@@ -80,7 +108,14 @@ namespace rt
             VoxelShape(ResourceRef<Resources::VoxelGridResource> grid, const std::string_view &name, const Transform &transform = Transform(), size_t materialIndex = 0);
             VoxelShape(ResourceRef<Resources::VoxelGridResource> grid = {}, const Transform &transform = Transform(), size_t materialIndex = 0);
 
+            virtual VoxelShape *clone() const override { return new VoxelShape(*this); }
+
             virtual std::optional<Intersection> intersect(const m::ray<double> &ray) const override;
+            // Only hits before tMax are found, so the traversal of the grid stops early behind a known hit
+            std::optional<Intersection> intersect(const m::ray<double> &ray, double tMax) const;
+            virtual bool                        occludes(const m::ray<double> &ray, double tMax) const override;
+
+            virtual std::optional<m::AABB<double>> getLocalBounds() const override;
 
             virtual bool onInspectorGUI() override;
 
@@ -1,6 +1,7 @@
 #ifndef TRANSFORM_HPP
 #define TRANSFORM_HPP
 
+#include <cstdint>
 #include <optional>
 #include <rtmath.h>
 
@@ -21,10 +22,22 @@ namespace rt
             m::dmat4 inverseTransposeMatrix;
         } mutable cached;
 
+    private:
+        // Incremented by markChanged, the cached matrices are only recomputed by updateCache when it differs
+        uint64_t         m_revision = 0;
+        mutable uint64_t m_cachedRevision = UINT64_MAX;
+
     public:
         Transform(const m::dvec3 &position = m::dvec3(0), const m::dquat &rotation = m::dquat(1, 0, 0, 0), const m::dvec3 &scale = m::dvec3(1));
 
+        // Has to be called after position, rotation or scale were changed
+        inline void     markChanged() { m_revision++; }
+        inline uint64_t getRevision() const { return m_revision; }
+
+        // Always recomputes the cached matrices
         void cacheMatrix() const;
+        // Recomputes the cached matrices only if the transform changed since they were cached, returns true if it did
+        bool updateCache() const;
     };
 
     std::ostream &operator<<(std::ostream &stream, const Transform &transform);
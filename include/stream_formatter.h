@@ -51,6 +51,14 @@ namespace rtstd
             : m_outStream(outStream), m_args(args) {}
         ~basic_formatterbuf() {}
 
+        // Forgets the indentation, e.g. of an unfinished log, so the buffer can be reused
+        void reset()
+        {
+            m_indentCount = 0;
+            m_drainWhitespace = false;
+            m_deactivateCount = 0;
+        }
+
     private:
         void writeIndent()
         {
@@ -162,6 +170,8 @@ namespace rtstd
         basic_formatterstream(child_type &outStream, const basic_formatterargs<_Elem> &args)
             : base(std::addressof(m_buffer)), m_buffer(outStream, args) {}
         ~basic_formatterstream() {}
+
+        inline void reset() { m_buffer.reset(); }
     };
 
     using formatterstream = basic_formatterstream<char, std::char_traits<char>>;
@@ -1,10 +1,16 @@
 #ifndef THREAD_POOL_HPP
 #define THREAD_POOL_HPP
 
-#include <vector>
-#include <thread>
+#include <algorithm>
+#include <atomic>
 #include <functional>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
 
+#include <cpu_dispatch.h>
 #include <event_stream.h>
 
 namespace rt
@@ -48,7 +54,8 @@ namespace rt
 
         ~ThreadPool();
 
-        inline bool isEmpty() const { return m_stream.isEmpty(); }
+        inline bool   isEmpty() const { return m_stream.isEmpty(); }
+        inline size_t getThreadCount() const { return m_workers.size(); }
 
         inline void clear() { m_stream.clear(); }
 
@@ -59,6 +66,12 @@ namespace rt
         void run();
     };
 
+    // Calls body(i) for every i in [0, count) on the pool, the calling thread takes part as well.
+    // Only indices that are already being processed are waited for, so this can be called from inside a pool task.
+    // Works with every pool of std::packaged_task<void()>, body must not throw.
+    template <typename _Pool, typename F>
+    void parallelFor(_Pool &pool, size_t count, F &&body);
+
     template <typename _Task>
     ThreadPool<_Task>::Event::Event(const _Task &task)
         : terminate(false), task(task) {}
@@ -86,7 +99,7 @@ namespace rt
         for (size_t i = 0; i < threadCount; i++)
             m_workers.emplace_back(&ThreadPool<_Task>::run, this);
 
-        std::cout << "Running with " << threadCount << " threads!" << std::endl;
+        std::cout << "Running with " << threadCount << " threads! Kernels: " << CpuDispatch::isaToString(CpuDispatch::getIsa()) << std::endl;
     }
 
     template <typename _Task>
@@ -125,6 +138,35 @@ namespace rt
         m_stream << std::move(task);
         return *this;
     }
+
+    template <typename _Pool, typename F>
+    void parallelFor(_Pool &pool, size_t count, F &&body)
+    {
+        struct State
+        {
+            std::atomic<size_t> next = 0;
+            std::atomic<size_t> done = 0;
+        };
+        // Helpers may start after this function returned, they only touch the shared state then
+        auto state = std::make_shared<State>();
+
+        auto work = [state, count, &body]()
+        {
+            for (size_t i; (i = state->next++) < count;)
+            {
+                body(i);
+                if (++state->done == count)
+                    state->done.notify_all();
+            }
+        };
+
+        for (size_t i = 1; i < std::min(pool.getThreadCount(), count); i++)
+            pool << typename _Pool::task_type(work);
+        work();
+
+        for (size_t done; (done = state->done) != count;)
+            state->done.wait(done);
+    }
 } // namespace rt
 
 #endif // THREAD_POOL_HPP
@@ -1,7 +1,11 @@
 #ifndef VOXEL_GRID_HPP
 #define VOXEL_GRID_HPP
 
-#include <cstring>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <optional>
+#include <vector>
 
 #include <rtmath.h>
 
@@ -9,6 +13,8 @@ namespace rt
 {
     namespace m = math;
 
+    // Sparse voxel grid, the grid is split into bricks of 8x8x8 voxels.
+    // Only bricks containing at least one filled voxel are stored, and every brick only stores its filled voxels.
     class VoxelGrid
     {
     public:
@@ -17,54 +23,81 @@ namespace rt
             unsigned char colorIndex;
         };
 
+        static constexpr size_t BrickBits = 3;
+        static constexpr size_t BrickSize = 1 << BrickBits;
+        static constexpr size_t BrickVolume = BrickSize * BrickSize * BrickSize;
+
+        struct Brick
+        {
+            // One bit per voxel, set if the voxel is filled
+            std::array<uint64_t, BrickVolume / 64> occupancy{};
+            // Number of filled voxels in all previous occupancy words
+            std::array<uint16_t, BrickVolume / 64> rank{};
+            // Filled voxels, ordered by their index in the brick
+            std::vector<Voxel> voxels;
+
+            inline bool isFilled(size_t index) const { return (occupancy[index / 64] >> (index % 64)) & 1; }
+
+            inline size_t voxelIndex(size_t index) const
+            {
+                uint64_t lowerBits = occupancy[index / 64] & ((uint64_t(1) << (index % 64)) - 1);
+                return rank[index / 64] + std::popcount(lowerBits);
+            }
+        };
+
+        static constexpr uint32_t EmptyBrick = UINT32_MAX;
+
     private:
         m::u64vec3 m_size;
+        m::u64vec3 m_brickCount;
 
-        Voxel *m_grid;
+        // Index into m_bricks for every brick of the grid, EmptyBrick if it has no filled voxels
+        std::vector<uint32_t> m_brickMap;
+        std::vector<Brick>    m_bricks;
 
     public:
-        inline size_t length() { return m_size.x * m_size.y * m_size.z; }
-
-        VoxelGrid(const m::u64vec3 &size, Voxel *grid)
-            : m_size(size), m_grid(grid) {}
         VoxelGrid(const m::u64vec3 &size)
-            : VoxelGrid(size, new Voxel[size.x * size.y * size.z])
-        {
-            std::memset(m_grid, 0, length() * sizeof(Voxel));
-        }
+            : m_size(size),
+              m_brickCount((size + m::u64vec3(BrickSize - 1)) / m::u64vec3(BrickSize)),
+              m_brickMap(m_brickCount.x * m_brickCount.y * m_brickCount.z, EmptyBrick) {}
 
-        VoxelGrid(const VoxelGrid &other)
-            : VoxelGrid(other.m_size, new Voxel[other.m_size.x * other.m_size.y * other.m_size.z])
+        inline size_t     length() const { return m_size.x * m_size.y * m_size.z; }
+        inline m::u64vec3 getSize() const { return m_size; }
+        inline m::u64vec3 getBrickCount() const { return m_brickCount; }
+
+        // Position is in bricks
+        inline const Brick *getBrick(const m::u64vec3 &brick) const
         {
-            std::memcpy(m_grid, other.m_grid, length() * sizeof(Voxel));
+            uint32_t index = m_brickMap[brick.x + brick.y * m_brickCount.x + brick.z * m_brickCount.x * m_brickCount.y];
+            return index == EmptyBrick ? nullptr : &m_bricks[index];
         }
 
-        VoxelGrid(VoxelGrid &&other)
-            : VoxelGrid(other.m_size, other.m_grid)
+        // Index of a voxel inside of its brick
+        static inline size_t indexInBrick(const m::u64vec3 &position)
         {
-            other.m_grid = nullptr;
-            other.m_size = m::u64vec3();
+            auto local = position & m::u64vec3(BrickSize - 1);
+            return local.x + (local.y << BrickBits) + (local.z << (2 * BrickBits));
         }
 
-        ~VoxelGrid()
+        inline Voxel at(const m::u64vec3 &position) const
         {
-            delete[] m_grid;
+            const Brick *brick = getBrick(position >> m::u64vec3(BrickBits));
+            if (!brick)
+                return {0};
+
+            size_t index = indexInBrick(position);
+            if (!brick->isFilled(index))
+                return {0};
+            return brick->voxels[brick->voxelIndex(index)];
         }
+        inline Voxel at(size_t x, size_t y, size_t z) const { return at({x, y, z}); }
 
-        inline m::u64vec3 getSize() { return m_size; }
+        void set(const m::u64vec3 &position, Voxel voxel);
 
-        inline Voxel &operator[](size_t index)
-        {
-            assert(index < length());
-            return m_grid[index];
-        }
-        inline Voxel &at(m::u64vec3 i)
-        {
-            return (*this)[i.x + i.y * m_size.x + i.z * m_size.x * m_size.y];
-        }
-        inline Voxel &at(size_t x, size_t y, size_t z) { return at({x, y, z}); }
+        // Bounds of all filled voxels in cells, std::nullopt if no voxel is filled
+        std::optional<m::AABB<double>> getOccupiedBounds() const;
     };
 
 } // namespace rt
 
-#endif // VOXEL_GRID_HPP
\ No newline at end of file
+#endif // VOXEL_GRID_HPP
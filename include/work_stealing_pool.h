@@ -0,0 +1,368 @@
+#ifndef WORK_STEALING_POOL_HPP
+#define WORK_STEALING_POOL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <cpu_dispatch.h>
+#include <cpu_topology.h>
+#include <thread_pool.h>
+
+namespace rt
+{
+    enum class PoolPriority
+    {
+        Normal,
+        // Workers run with the lowest scheduling priority, the OS preempts them for the workers of normal pools
+        Background,
+    };
+
+    // Lowers the scheduling priority of the calling thread
+    void lowerThreadPriority();
+
+    // Thread pool with one task deque per worker instead of a single shared queue.
+    // Workers push and pop their own tasks at the back of their deque and steal from the front of a random other deque
+    // when theirs is empty, so the lock of a deque is almost never contended.
+    // Tasks submitted from outside the pool are spread over the deques round robin.
+    // Workers can be pinned to cpus, thieves then prefer victims on their own NUMA node.
+    // A task may submit more tasks and wait for them (fork/join), as long as it takes part in the work like parallelFor does.
+    // Data parallel loops are shared by all workers without submitting any tasks, see parallelFor.
+    template <typename _Task>
+    class WorkStealingPool
+    {
+    public:
+        using task_type = _Task;
+
+    private:
+        struct alignas(64) Worker
+        {
+            std::mutex            mutex;
+            std::deque<task_type> tasks;
+            size_t                node = 0;
+        };
+
+        // Loops are split into at most this many contiguous ranges, one per NUMA node
+        static constexpr size_t MaxLoopRanges = 8;
+
+        // Loop of parallelFor, it lives on the stack of the thread running it
+        struct Loop
+        {
+            struct alignas(64) Range
+            {
+                std::atomic<size_t> next = 0;
+                size_t              end = 0;
+            };
+
+            Range               ranges[MaxLoopRanges];
+            size_t              rangeCount;
+            std::atomic<size_t> done = 0;
+            size_t              count;
+            void               *body;
+            void (*invoke)(void *body, size_t i);
+        };
+
+        std::vector<std::unique_ptr<Worker>> m_queues;
+        std::vector<std::thread>             m_workers;
+        size_t                               m_nodeCount = 1;
+
+        // Only one loop is shared with the workers at a time
+        std::atomic<Loop *> m_loop = nullptr;
+        // Workers, that may still access the shared loop, it can only leave the stack once this is 0
+        std::atomic<size_t> m_loopUsers = 0;
+
+        // Number of queued tasks, that no worker took yet
+        std::atomic<size_t> m_pending = 0;
+        // Incremented on every submission, idle workers sleep until it changes
+        std::atomic<uint32_t> m_epoch = 0;
+        std::atomic<size_t>   m_nextQueue = 0;
+        std::atomic<bool>     m_terminate = false;
+
+        // Pool and queue index of the worker running on the current thread
+        inline static thread_local WorkStealingPool *t_pool = nullptr;
+        inline static thread_local size_t            t_index = 0;
+
+    public:
+        WorkStealingPool(size_t threadCount, PoolPriority priority = PoolPriority::Normal);
+        // One worker per placement, pinned to its cpus
+        WorkStealingPool(const std::vector<CpuTopology::WorkerPlacement> &placement, PoolPriority priority = PoolPriority::Normal);
+
+        WorkStealingPool(const WorkStealingPool &) = delete;
+        WorkStealingPool(WorkStealingPool &&) = delete;
+
+        ~WorkStealingPool();
+
+        inline bool   isEmpty() const { return m_pending == 0; }
+        inline size_t getThreadCount() const { return m_workers.size(); }
+        inline size_t getNodeCount() const { return m_nodeCount; }
+
+        void clear();
+
+        WorkStealingPool &operator<<(const task_type &task);
+        WorkStealingPool &operator<<(task_type &&task);
+
+        // Calls body(i) for every i in [0, count) on all workers and the calling thread, returns once all calls finished.
+        // Workers pull the indices from one atomic counter and the caller waits on a single counter of finished calls,
+        // nothing is allocated. Loops started while another one is shared, e.g. nested ones, fall back to rt::parallelFor.
+        // With workers on several NUMA nodes the indices are split into one contiguous range per node, workers take the
+        // indices of their own node first, so neighbouring indices and the memory they touch first stay on one node.
+        // body must not throw.
+        template <typename F>
+        void parallelFor(size_t count, F &&body);
+
+    private:
+        template <typename T>
+        void push(T &&task);
+        std::optional<task_type> pop(size_t index);
+        std::optional<task_type> steal(size_t index, std::minstd_rand &random);
+
+        // Returns true if the loop still had indices left
+        static bool runLoop(Loop &loop, size_t node);
+        bool        joinLoop();
+
+        // Node of the calling thread, 0 for threads outside the pool
+        inline size_t currentNode() const { return t_pool == this ? m_queues[t_index]->node : 0; }
+
+        void run(size_t index, std::vector<int> cpus, PoolPriority priority);
+    };
+
+    template <typename _Task>
+    WorkStealingPool<_Task>::WorkStealingPool(size_t threadCount, PoolPriority priority)
+        : WorkStealingPool(std::vector<CpuTopology::WorkerPlacement>(std::max<size_t>(threadCount, 1)), priority)
+    {
+    }
+
+    template <typename _Task>
+    WorkStealingPool<_Task>::WorkStealingPool(const std::vector<CpuTopology::WorkerPlacement> &placement, PoolPriority priority)
+    {
+        size_t threadCount = std::max<size_t>(placement.size(), 1);
+
+        m_queues.reserve(threadCount);
+        for (size_t i = 0; i < threadCount; i++)
+        {
+            m_queues.push_back(std::make_unique<Worker>());
+            if (i < placement.size())
+                m_queues.back()->node = placement[i].node;
+            m_nodeCount = std::max(m_nodeCount, m_queues.back()->node + 1);
+        }
+
+        m_workers.reserve(threadCount);
+        for (size_t i = 0; i < threadCount; i++)
+            m_workers.emplace_back(&WorkStealingPool<_Task>::run, this, i, i < placement.size() ? placement[i].cpus : std::vector<int>(), priority);
+
+        std::cout << "Running with " << threadCount << " threads";
+        if (m_nodeCount > 1)
+            std::cout << " on " << m_nodeCount << " NUMA nodes";
+        std::cout << "! Kernels: " << CpuDispatch::isaToString(CpuDispatch::getIsa()) << std::endl;
+    }
+
+    template <typename _Task>
+    WorkStealingPool<_Task>::~WorkStealingPool()
+    {
+        m_terminate = true;
+        m_epoch++;
+        m_epoch.notify_all();
+        for (auto &&worker : m_workers)
+            worker.join();
+    }
+
+    template <typename _Task>
+    void WorkStealingPool<_Task>::clear()
+    {
+        for (auto &&queue : m_queues)
+        {
+            std::lock_guard<std::mutex> lk(queue->mutex);
+            m_pending -= queue->tasks.size();
+            queue->tasks.clear();
+        }
+    }
+
+    template <typename _Task>
+    template <typename T>
+    void WorkStealingPool<_Task>::push(T &&task)
+    {
+        // Workers keep their own tasks local, that is where nested work is waited for
+        size_t index = t_pool == this ? t_index : m_nextQueue++ % m_queues.size();
+        // Counted before the task is visible, so the counter never drops below zero when it is taken right away
+        m_pending++;
+        {
+            Worker                     &queue = *m_queues[index];
+            std::lock_guard<std::mutex> lk(queue.mutex);
+            queue.tasks.emplace_back(std::forward<T>(task));
+        }
+        m_epoch++;
+        m_epoch.notify_one();
+    }
+
+    template <typename _Task>
+    std::optional<_Task> WorkStealingPool<_Task>::pop(size_t index)
+    {
+        Worker                     &queue = *m_queues[index];
+        std::lock_guard<std::mutex> lk(queue.mutex);
+        if (queue.tasks.empty())
+            return std::nullopt;
+
+        std::optional<task_type> task(std::move(queue.tasks.back()));
+        queue.tasks.pop_back();
+        m_pending--;
+        return task;
+    }
+
+    template <typename _Task>
+    std::optional<_Task> WorkStealingPool<_Task>::steal(size_t index, std::minstd_rand &random)
+    {
+        // Victims are visited from a random start, so thieves don't all pile onto the same deque.
+        // Workers of the own node are tried first, their tasks likely use memory of this node.
+        size_t count = m_queues.size();
+        size_t start = random() % count;
+        size_t node = m_queues[index]->node;
+        for (int pass = 0; pass < (m_nodeCount > 1 ? 2 : 1); pass++)
+            for (size_t i = 0; i < count; i++)
+            {
+                size_t victim = (start + i) % count;
+                if (victim == index || (m_nodeCount > 1 && (m_queues[victim]->node == node) != (pass == 0)))
+                    continue;
+
+                Worker                      &queue = *m_queues[victim];
+                std::unique_lock<std::mutex> lk(queue.mutex, std::try_to_lock);
+                if (!lk.owns_lock() || queue.tasks.empty())
+                    continue;
+
+                std::optional<task_type> task(std::move(queue.tasks.front()));
+                queue.tasks.pop_front();
+                m_pending--;
+                return task;
+            }
+        return std::nullopt;
+    }
+
+    template <typename _Task>
+    void WorkStealingPool<_Task>::run(size_t index, std::vector<int> cpus, PoolPriority priority)
+    {
+        t_pool = this;
+        t_index = index;
+        // The worker still runs unpinned, only stealing by node may then prefer the wrong victims
+        if (!CpuTopology::pinCurrentThread(cpus))
+            std::cerr << "Could not pin worker " << index << " to its cpus\n";
+        if (priority == PoolPriority::Background)
+            lowerThreadPriority();
+
+        std::minstd_rand random((uint32_t)index + 1);
+        while (!m_terminate)
+        {
+            // The epoch is read before checking for work, so a submission in between wakes the worker right away
+            uint32_t epoch = m_epoch;
+
+            if (joinLoop())
+                continue;
+
+            std::optional<task_type> task = pop(index);
+            if (!task)
+                task = steal(index, random);
+            if (task)
+            {
+                (*task)();
+                continue;
+            }
+
+            if (m_pending == 0 && !m_terminate)
+                m_epoch.wait(epoch);
+        }
+    }
+
+    template <typename _Task>
+    bool WorkStealingPool<_Task>::runLoop(Loop &loop, size_t node)
+    {
+        // The range of the own node first, then the ones of the other nodes once it is exhausted
+        bool worked = false;
+        for (size_t r = 0; r < loop.rangeCount; r++)
+        {
+            auto &range = loop.ranges[(node + r) % loop.rangeCount];
+            for (size_t i; (i = range.next++) < range.end;)
+            {
+                loop.invoke(loop.body, i);
+                worked = true;
+                if (++loop.done == loop.count)
+                    loop.done.notify_all();
+            }
+        }
+        return worked;
+    }
+
+    template <typename _Task>
+    bool WorkStealingPool<_Task>::joinLoop()
+    {
+        if (!m_loop)
+            return false;
+
+        // Registered before the loop is read again, so the thread running it waits until this worker let go of it
+        m_loopUsers++;
+        bool worked = false;
+        if (Loop *loop = m_loop)
+            worked = runLoop(*loop, currentNode());
+        if (--m_loopUsers == 0)
+            m_loopUsers.notify_all();
+        return worked;
+    }
+
+    template <typename _Task>
+    template <typename F>
+    void WorkStealingPool<_Task>::parallelFor(size_t count, F &&body)
+    {
+        if (count == 0)
+            return;
+
+        Loop loop;
+        loop.count = count;
+        loop.body = (void *)&body;
+        loop.invoke = [](void *body, size_t i)
+        { (*(std::remove_reference_t<F> *)body)(i); };
+        loop.rangeCount = std::min({m_nodeCount, MaxLoopRanges, count});
+        for (size_t r = 0; r < loop.rangeCount; r++)
+        {
+            loop.ranges[r].next = count * r / loop.rangeCount;
+            loop.ranges[r].end = count * (r + 1) / loop.rangeCount;
+        }
+
+        Loop *expected = nullptr;
+        if (!m_loop.compare_exchange_strong(expected, &loop))
+        {
+            rt::parallelFor(*this, count, body);
+            return;
+        }
+
+        m_epoch++;
+        m_epoch.notify_all();
+
+        runLoop(loop, currentNode());
+        for (size_t done; (done = loop.done) != count;)
+            loop.done.wait(done);
+
+        m_loop = nullptr;
+        for (size_t users; (users = m_loopUsers) != 0;)
+            m_loopUsers.wait(users);
+    }
+
+    template <typename _Task>
+    WorkStealingPool<_Task> &WorkStealingPool<_Task>::operator<<(const task_type &task)
+    {
+        push(task);
+        return *this;
+    }
+
+    template <typename _Task>
+    WorkStealingPool<_Task> &WorkStealingPool<_Task>::operator<<(task_type &&task)
+    {
+        push(std::move(task));
+        return *this;
+    }
+} // namespace rt
+
+#endif // WORK_STEALING_POOL_HPP
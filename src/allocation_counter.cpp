@@ -0,0 +1,94 @@
+#include <profiler.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// Replaces the global allocation functions to count the heap allocations of the whole process and of every thread
+
+namespace Profiling
+{
+    static std::atomic<uint64_t> s_allocations = 0;
+    static thread_local uint64_t t_allocations = 0;
+
+    uint64_t getAllocations() { return s_allocations.load(std::memory_order_relaxed); }
+    uint64_t getThreadAllocations() { return t_allocations; }
+} // namespace Profiling
+
+static void *countedAllocate(size_t size)
+{
+    Profiling::s_allocations.fetch_add(1, std::memory_order_relaxed);
+    Profiling::t_allocations++;
+    return std::malloc(size == 0 ? 1 : size);
+}
+
+static void *countedAllocateAligned(size_t size, std::align_val_t alignment)
+{
+    Profiling::s_allocations.fetch_add(1, std::memory_order_relaxed);
+    Profiling::t_allocations++;
+#ifdef _WIN32
+    return _aligned_malloc(size == 0 ? 1 : size, (size_t)alignment);
+#else
+    // aligned_alloc needs a multiple of the alignment
+    size_t align = std::max<size_t>((size_t)alignment, sizeof(void *));
+    return std::aligned_alloc(align, (std::max<size_t>(size, 1) + align - 1) / align * align);
+#endif
+}
+
+static void freeAligned(void *ptr)
+{
+#ifdef _WIN32
+    _aligned_free(ptr);
+#else
+    std::free(ptr);
+#endif
+}
+
+void *operator new(size_t size)
+{
+    if (void *ptr = countedAllocate(size))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void *operator new[](size_t size)
+{
+    if (void *ptr = countedAllocate(size))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept { return countedAllocate(size); }
+void *operator new[](size_t size, const std::nothrow_t &) noexcept { return countedAllocate(size); }
+
+void *operator new(size_t size, std::align_val_t alignment)
+{
+    if (void *ptr = countedAllocateAligned(size, alignment))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void *operator new[](size_t size, std::align_val_t alignment)
+{
+    if (void *ptr = countedAllocateAligned(size, alignment))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void *operator new(size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept { return countedAllocateAligned(size, alignment); }
+void *operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept { return countedAllocateAligned(size, alignment); }
+
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete[](void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { std::free(ptr); }
+void operator delete[](void *ptr, size_t) noexcept { std::free(ptr); }
+void operator delete(void *ptr, const std::nothrow_t &) noexcept { std::free(ptr); }
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept { std::free(ptr); }
+
+void operator delete(void *ptr, std::align_val_t) noexcept { freeAligned(ptr); }
+void operator delete[](void *ptr, std::align_val_t) noexcept { freeAligned(ptr); }
+void operator delete(void *ptr, size_t, std::align_val_t) noexcept { freeAligned(ptr); }
+void operator delete[](void *ptr, size_t, std::align_val_t) noexcept { freeAligned(ptr); }
+void operator delete(void *ptr, std::align_val_t, const std::nothrow_t &) noexcept { freeAligned(ptr); }
+void operator delete[](void *ptr, std::align_val_t, const std::nothrow_t &) noexcept { freeAligned(ptr); }
@@ -1,6 +1,11 @@
 #include <application.h>
 
+#include <algorithm>
+#include <chrono>
+#include <frame_pipeline.h>
+#include <fstream>
 #include <optional>
+#include <profiler.h>
 #include <resource_loaders.h>
 #include <resources.h>
 #include <rt_renderer.h>
@@ -15,14 +20,20 @@ namespace rt
     Application::Application(const std::filesystem::path &originPath, bool useGui,
                              std::optional<std::filesystem::path> sceneFile,
                              std::optional<std::filesystem::path> outputPath,
-                             m::u64vec2                           outputSize)
+                             m::u64vec2                           outputSize,
+                             std::optional<size_t>                loaderThreads,
+                             const CpuTopology::PlacementOptions &placement)
         : originPath(originPath),
-          threadPool(std::thread::hardware_concurrency() == 0 ? 1 : std::thread::hardware_concurrency()),
-          resources(&threadPool, originPath / "resource"),
+          threadPool(CpuTopology::placeWorkers(placement)),
+          loaderPool(loaderThreads.value_or(std::max<size_t>(std::thread::hardware_concurrency() / 4, 1)), PoolPriority::Background),
+          // Half of the cpus next to the previews, without previews an output job is the only work
+          jobPool(std::max<size_t>(std::thread::hardware_concurrency() / (useGui ? 2 : 1), 1), PoolPriority::Background),
+          resources(&loaderPool, originPath / "resource"),
           scene(std::make_unique<Scene>(
               Camera(Transform(m::dvec3(0, 3.5, 7))) //
               )),
           renderThread(&threadPool),
+          renderJobs(&jobPool, &resources),
           savePath(sceneFile),
           outputSize(outputSize),
           outputPath(outputPath),
@@ -31,10 +42,14 @@ namespace rt
     {
         if (useGui)
             m_window.emplace(*this);
-        renderers.emplace("Raytracing", new RTRenderer());
+        renderers.emplace("Raytracing", new BasicRTRenderer<double>());
+        renderers.emplace("Raytracing (float)", new BasicRTRenderer<float>());
         renderThread.setRenderer(renderers["Raytracing"].get());
+        // Resources decoded in the meantime only become visible between frames, never while the scene of one is compiled
+        renderThread.frameBoundary = [this]
+        { resources.publish(); };
 
-        resources.add<Resources::VoxelGridResource>(new ResourceLoaders::VoxelGridLoader());
+        resources.add<Resources::VoxelGridResource>(new ResourceLoaders::VoxelGridLoader(&loaderPool));
         resources.add<Resources::TextureResource>(new ResourceLoaders::TextureLoader());
 
         if (sceneFile)
@@ -51,6 +66,23 @@ namespace rt
     {
     }
 
+    // One report per named run, e.g. per scene and renderer of a benchmark
+    static void writeReports(const std::filesystem::path &path, const std::vector<std::pair<std::string, Profiling::FrameReport::Summary>> &reports)
+    {
+        std::ofstream file(path);
+        if (!file)
+            throw std::runtime_error("Could not open report file " + path.string());
+
+        file << "{\"runs\": [";
+        for (size_t i = 0; i < reports.size(); i++)
+        {
+            file << (i == 0 ? "\n  " : ",\n  ") << "{\"name\": \"" << reports[i].first << "\", \"report\": ";
+            Profiling::writeJson(file, reports[i].second);
+            file << "}";
+        }
+        file << "\n]}\n";
+    }
+
     void Application::run()
     {
         if (!useGui)
@@ -58,7 +90,32 @@ namespace rt
             if (!outputPath)
                 throw std::runtime_error("No output path specified");
             resources.waitForFinishLoading();
-            renderOutput(*outputPath, outputSize);
+            // There are no previews, so the output is profiled
+            uint64_t job = renderOutput(*outputPath, outputSize, 0, true);
+
+            RenderJobQueue::JobStatus status;
+            do
+            {
+                status = renderJobs.waitFor(job, std::chrono::seconds(1));
+                std::cout << "\r" << status.name << ": " << std::fixed << std::setprecision(1) << 100 * status.progress << "%, "
+                          << status.elapsed << " s";
+                if (status.remaining)
+                    std::cout << ", ETA " << *status.remaining << " s";
+                std::cout << "    " << std::flush;
+            } while (status.state == RenderJobQueue::JobState::Queued || status.state == RenderJobQueue::JobState::Running);
+            std::cout << std::endl;
+
+            if (status.state != RenderJobQueue::JobState::Finished)
+                throw std::runtime_error("Rendering the output " + std::string(jobStateToString(status.state)) + ": " + status.error);
+
+            RayStats rayStats;
+            double   traceTime;
+            RayStats::getTotal(rayStats, traceTime);
+            auto report = Profiling::profiler.getReport();
+            std::cout << std::setprecision(2) << rayStats.getMraysPerSecond(traceTime) << " Mrays/s\n"
+                      << rayStats << report << std::flush;
+            if (reportPath)
+                writeReports(*reportPath, {{status.name, report}});
             return;
         }
         bool running = true;
@@ -70,7 +127,7 @@ namespace rt
             case EventType::RenderOutput:
             {
                 auto &e = std::get<Events::RenderOutput>(event);
-                renderOutput(e.path, e.size);
+                renderOutput(e.path, e.size, e.priority);
             }
             break;
             case EventType::CloseApplication:
@@ -113,32 +170,141 @@ namespace rt
         }
     }
 
-    void Application::renderOutput(const std::filesystem::path &path, m::u64vec2 size)
+    void Application::benchmark(size_t frames)
     {
+        std::vector<std::filesystem::path> sceneFiles;
+        for (auto &&entry : std::filesystem::directory_iterator(originPath / "resource" / "scenes"))
+            if (entry.path().extension() == ".yaml")
+                sceneFiles.push_back(entry.path());
+        std::sort(sceneFiles.begin(), sceneFiles.end());
 
         renderThread.waitUntilFinished();
 
-        FrameBuffer frameBuffer(size.x, size.y);
+        FrameBuffer  frameBuffer(outputSize.x, outputSize.y);
+        RenderParams params = renderThread.renderParams;
 
-        renderThread.startRender(*scene, frameBuffer);
-        renderThread.waitUntilStarted();
-        renderThread.waitUntilFinished();
+        std::cout << "Benchmark at " << outputSize.x << "x" << outputSize.y << ", " << frames << " frames per scene and renderer\n";
+        std::cout << "Profiler overhead " << std::fixed << std::setprecision(1) << Profiling::profiler.measureOverhead() << " ns per event\n";
 
+        std::vector<std::pair<std::string, Profiling::FrameReport::Summary>> reports;
+        for (auto &&path : sceneFiles)
+        {
+            loadScene(path);
+            resources.waitForFinishLoading();
+            auto snapshot = scene->snapshot();
+
+            std::cout << path.filename().string() << ":\n";
+            for (auto &&[name, renderer] : renderers)
+            {
+                // Frames are rendered directly on this thread, the first one warms up caches and resources
+                std::vector<double> times;
+                double              idle = 0;
+                double              mrays = 0;
+                uint64_t            allocations = 0;
+                for (size_t i = 0; i <= frames; i++)
+                {
+                    // The warm up frame is left out of the report
+                    if (i == 1)
+                        Profiling::profiler.clearReport();
+
+                    uint64_t allocationsBefore = Profiling::getAllocations();
+                    auto     start = std::chrono::steady_clock::now();
+                    Profiling::profiler.beginFrame();
+                    renderer->doRender(&threadPool, snapshot, &frameBuffer, &params);
+                    Profiling::profiler.endFrame();
+                    auto end = std::chrono::steady_clock::now();
+                    if (i > 0)
+                    {
+                        times.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+                        auto &stats = renderer->getTileStats();
+                        idle += stats.idleTime / (stats.workerCount * stats.frameTime);
+                        mrays += renderer->getRayStats().getMraysPerSecond(stats.frameTime);
+                        allocations += Profiling::getAllocations() - allocationsBefore;
+                    }
+                }
+                std::sort(times.begin(), times.end());
+                auto report = Profiling::profiler.getReport();
+                reports.emplace_back(path.stem().string() + "/" + name, report);
+
+                // The same frames as a headless job, preparing and tone mapping overlap with tracing the neighbouring frames
+                size_t        requested = 0;
+                FramePipeline pipeline;
+                pipeline.next = [&](bool wait) -> std::unique_ptr<Renderer::FrameContext>
+                {
+                    if (requested == frames)
+                        return nullptr;
+                    requested++;
+
+                    auto frame = std::make_unique<Renderer::FrameContext>();
+                    frame->renderer = renderer.get();
+                    frame->threadPool = &threadPool;
+                    frame->scene = snapshot;
+                    frame->frameBuffer = &frameBuffer;
+                    frame->renderParams = params;
+                    frame->frame = requested;
+                    return frame;
+                };
+                auto start = std::chrono::steady_clock::now();
+                pipeline.run(threadPool);
+                double pipelined = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / frames;
+
+                std::cout << "    " << std::left << std::setw(24) << name << std::right << std::fixed << std::setprecision(2)
+                          << "median " << std::setw(9) << times[times.size() / 2] << " ms, min " << std::setw(9) << times.front() << " ms"
+                          << ", pipelined " << std::setw(9) << pipelined << " ms"
+                          << ", idle " << std::setprecision(1) << std::setw(5) << 100 * idle / frames << "%"
+                          << ", " << std::setprecision(2) << std::setw(8) << mrays / frames << " Mrays/s"
+                          << ", p95 " << std::setw(9) << report.p95 << " ms, p99 " << std::setw(9) << report.p99 << " ms"
+                          << ", utilisation " << std::setprecision(1) << std::setw(5) << 100 * report.utilisation << "%"
+                          << ", scheduling " << std::setprecision(2) << 1000 * report.schedulingPerTile << " us/tile"
+                          << ", " << allocations / frames << " allocations/frame\n";
+            }
+        }
+        std::cout << std::flush;
+
+        if (reportPath)
+            writeReports(*reportPath, reports);
+    }
+
+    static void writeJpg(const std::filesystem::path &path, const FrameBuffer &frameBuffer)
+    {
+        m::u64vec2             size = frameBuffer.getSize();
         std::vector<m::u8vec3> data(size.x * size.y);
         for (size_t y = 0; y < size.y; y++)
             for (size_t x = 0; x < size.x; x++)
                 data[y * size.x + x] = frameBuffer.at(x, size.y - y - 1) * 255.0f;
 
-        stbi_write_jpg(path.string().c_str(), (int)frameBuffer.getWidth(), (int)frameBuffer.getHeight(), 3, data.data(), 100);
+        stbi_write_jpg(path.string().c_str(), (int)size.x, (int)size.y, 3, data.data(), 100);
+    }
+
+    uint64_t Application::renderOutput(const std::filesystem::path &path, m::u64vec2 size, int priority, bool profile)
+    {
+        // The job has a scene and renderer of its own, so it runs next to the previews
+        RenderJobQueue::Job job;
+        job.name = path.filename().string();
+        job.priority = priority;
+        job.scene = scene->detachedSnapshot();
+        job.renderer = renderThread.getRenderer()->createInstance();
+        job.renderParams = renderThread.renderParams;
+        job.renderParams.logPixel = std::nullopt;
+        job.size = size;
+        job.profile = profile;
+        job.finished = [path](const FrameBuffer &frameBuffer)
+        { writeJpg(path, frameBuffer); };
+
+        // The heatmap of the previews must not replace the output
+        job.renderParams.heatmap = outputHeatmap;
+        job.renderParams.showHeatmap = false;
+        job.heatmapFinished = [path](const FrameBuffer &heatmap)
+        { writeJpg(path.parent_path() / (path.stem().string() + ".heatmap.jpg"), heatmap); };
+        return renderJobs.submit(std::move(job));
     }
 
     void Application::loadScene(const std::filesystem::path &path)
     {
         static SceneDeserializer deserializer(&resources, originPath / "resource");
 
+        // Frames in flight render snapshots, the scene can be replaced right away
         auto scene = deserializer.deserializeFile(path);
-
-        renderThread.waitUntilFinished();
         this->scene = std::unique_ptr<Scene>(scene);
     }
 
@@ -173,7 +339,6 @@ namespace rt
 
         scene->addLight(new Lights::DirectionalLight(m::dvec3(0.663, 0.608, -0.438), m::Color<float>(255, 248, 208) / 255.0f, 0.5f));
 
-        renderThread.waitUntilFinished();
         this->scene = std::move(scene);
     }
 }
\ No newline at end of file
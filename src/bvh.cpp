@@ -0,0 +1,218 @@
+#include <bvh.h>
+
+#include <cmath>
+#include <numeric>
+
+namespace rt
+{
+    static constexpr size_t BinCount = 16;
+    static constexpr size_t MaxLeafSize = 4;
+
+    // Relative costs used by the surface area heuristic
+    static constexpr double TraversalCost = 1.0;
+    static constexpr double IntersectionCost = 1.5;
+
+    // Converts bounds to the scalar type of the nodes, rounding outwards so no primitive is missed by the traversal
+    template <typename T>
+    static inline m::AABB<T> toNodeBounds(const m::AABB<double> &bounds)
+    {
+        m::AABB<T> result(m::vec3<T>(bounds.min), m::vec3<T>(bounds.max));
+        for (int i = 0; i < 3; i++)
+        {
+            if (result.min[i] > bounds.min[i])
+                result.min[i] = std::nextafter(result.min[i], -std::numeric_limits<T>::infinity());
+            if (result.max[i] < bounds.max[i])
+                result.max[i] = std::nextafter(result.max[i], std::numeric_limits<T>::infinity());
+        }
+        return result;
+    }
+
+    template <typename T>
+    void BasicBVH<T>::build(const std::vector<m::AABB<double>> &bounds)
+    {
+        clear();
+        if (bounds.empty())
+            return;
+
+        m_indices.resize(bounds.size());
+        std::iota(m_indices.begin(), m_indices.end(), 0);
+
+        std::vector<m::dvec3> centroids;
+        centroids.reserve(bounds.size());
+        for (auto &&b : bounds)
+            centroids.push_back(b.getCenter());
+
+        // A binary tree with n leaves has 2n - 1 nodes, so the node references stay valid while building
+        m_nodes.reserve(bounds.size() * 2 - 1);
+        m_nodes.emplace_back();
+
+        subdivide(0, 0, (uint32_t)bounds.size(), 0, bounds, centroids);
+
+        m_bounds.reserve(bounds.size());
+        for (uint32_t index : m_indices)
+            m_bounds.push_back(bounds[index]);
+    }
+
+    template <typename T>
+    void BasicBVH<T>::clear()
+    {
+        m_nodes.clear();
+        m_indices.clear();
+        m_bounds.clear();
+    }
+
+    template <typename T>
+    void BasicBVH<T>::setBounds(uint32_t i, const m::AABB<double> &bounds)
+    {
+        m_bounds[i] = bounds;
+    }
+
+    template <typename T>
+    void BasicBVH<T>::refit()
+    {
+        // Children are always stored after their parent, so walking backwards visits them first
+        for (size_t i = m_nodes.size(); i-- > 0;)
+        {
+            Node &node = m_nodes[i];
+            if (node.isLeaf())
+            {
+                m::AABB<double> bounds;
+                for (uint32_t j = node.first; j < node.first + node.count; j++)
+                    bounds.grow(m_bounds[j]);
+                node.bounds = toNodeBounds<T>(bounds);
+            }
+            else
+            {
+                node.bounds = m_nodes[node.first].bounds;
+                node.bounds.grow(m_nodes[node.first + 1].bounds);
+            }
+        }
+    }
+
+    template <typename T>
+    void BasicBVH<T>::subdivide(uint32_t nodeIndex, uint32_t first, uint32_t count, size_t depth,
+                        const std::vector<m::AABB<double>> &bounds, const std::vector<m::dvec3> &centroids)
+    {
+        Node &node = m_nodes[nodeIndex];
+
+        m::AABB<double> nodeBounds, centroidBounds;
+        for (uint32_t i = first; i < first + count; i++)
+        {
+            nodeBounds.grow(bounds[m_indices[i]]);
+            centroidBounds.grow(centroids[m_indices[i]]);
+        }
+
+        node.bounds = toNodeBounds<T>(nodeBounds);
+        node.first = first;
+        node.count = count;
+
+        if (count <= MaxLeafSize)
+            return;
+
+        // Find the cheapest split over all axes with binned SAH
+        m::dvec3 extent = centroidBounds.getExtent();
+
+        int    bestAxis = -1;
+        size_t bestSplit = 0;
+        double bestCost = std::numeric_limits<double>::infinity();
+
+        for (int axis = 0; axis < 3; axis++)
+        {
+            if (extent[axis] <= 0)
+                continue;
+
+            struct Bin
+            {
+                m::AABB<double> bounds;
+                uint32_t        count = 0;
+            } bins[BinCount];
+
+            double scale = BinCount / extent[axis];
+            for (uint32_t i = first; i < first + count; i++)
+            {
+                uint32_t index = m_indices[i];
+                size_t   bin = std::min(BinCount - 1, (size_t)((centroids[index][axis] - centroidBounds.min[axis]) * scale));
+                bins[bin].bounds.grow(bounds[index]);
+                bins[bin].count++;
+            }
+
+            // Sweep from the right to get the cost of every right side
+            double          rightArea[BinCount - 1];
+            uint32_t        rightCount[BinCount - 1];
+            m::AABB<double> accumulated;
+            uint32_t        accumulatedCount = 0;
+            for (size_t i = BinCount - 1; i > 0; i--)
+            {
+                accumulated.grow(bins[i].bounds);
+                accumulatedCount += bins[i].count;
+                rightArea[i - 1] = accumulatedCount ? accumulated.getSurfaceArea() : 0;
+                rightCount[i - 1] = accumulatedCount;
+            }
+
+            accumulated = m::AABB<double>();
+            accumulatedCount = 0;
+            for (size_t i = 0; i < BinCount - 1; i++)
+            {
+                accumulated.grow(bins[i].bounds);
+                accumulatedCount += bins[i].count;
+                if (accumulatedCount == 0 || rightCount[i] == 0)
+                    continue;
+
+                double cost = accumulated.getSurfaceArea() * accumulatedCount + rightArea[i] * rightCount[i];
+                if (cost < bestCost)
+                {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestSplit = i;
+                }
+            }
+        }
+
+        uint32_t leftCount = 0;
+
+        if (depth + 1 >= MaxDepth || bestAxis == -1)
+        {
+            // Either all centroids are in the same spot, or the tree gets too deep.
+            // Split in the middle of the list along the widest axis, this keeps the depth logarithmic.
+            if (extent.x <= 0 && extent.y <= 0 && extent.z <= 0 && depth + 1 < MaxDepth)
+                return;
+
+            int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+            leftCount = count / 2;
+            std::nth_element(m_indices.begin() + first, m_indices.begin() + first + leftCount, m_indices.begin() + first + count,
+                             [&](uint32_t a, uint32_t b)
+                             { return centroids[a][axis] < centroids[b][axis]; });
+        }
+        else
+        {
+            double leafCost = IntersectionCost * count;
+            double splitCost = TraversalCost + IntersectionCost * bestCost / nodeBounds.getSurfaceArea();
+            if (splitCost >= leafCost)
+                return;
+
+            double scale = BinCount / extent[bestAxis];
+            auto   middle = std::partition(m_indices.begin() + first, m_indices.begin() + first + count,
+                                           [&](uint32_t index)
+                                           {
+                                               size_t bin = std::min(BinCount - 1, (size_t)((centroids[index][bestAxis] - centroidBounds.min[bestAxis]) * scale));
+                                               return bin <= bestSplit; });
+            leftCount = (uint32_t)(middle - (m_indices.begin() + first));
+        }
+
+        if (leftCount == 0 || leftCount == count)
+            return;
+
+        uint32_t left = (uint32_t)m_nodes.size();
+        m_nodes.emplace_back();
+        m_nodes.emplace_back();
+
+        node.first = left;
+        node.count = 0;
+
+        subdivide(left, first, leftCount, depth + 1, bounds, centroids);
+        subdivide(left + 1, first + leftCount, count - leftCount, depth + 1, bounds, centroids);
+    }
+
+    template class BasicBVH<float>;
+    template class BasicBVH<double>;
+} // namespace rt
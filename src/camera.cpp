@@ -27,6 +27,7 @@ namespace rt
 
     void Camera::cacheMatrix(double aspect) const
     {
+        // The camera controller moves the camera almost every frame without marking it, so it is always recomputed
         transform.cacheMatrix();
         auto pers = m::perspective<double>(FOV, aspect, zNear, zFar);
         cached.matrix = pers * transform.cached.inverseMatrix;
@@ -0,0 +1,102 @@
+#include <chrome_trace.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace Profiling
+{
+    // Process and track ids of the trace, track 0 holds the frames
+    static constexpr int    ProcessId = 1;
+    static constexpr size_t FrameTrack = 0;
+
+    static void writeString(std::ostream &stream, const char *string)
+    {
+        stream << '"';
+        for (const char *c = string; *c != '\0'; c++)
+        {
+            if (*c == '"' || *c == '\\')
+                stream << '\\';
+            stream << *c;
+        }
+        stream << '"';
+    }
+
+    ChromeTrace::ChromeTrace(const std::filesystem::path &path)
+        : m_file(path)
+    {
+        if (!m_file)
+            throw std::runtime_error("Could not open trace file " + path.string());
+
+        m_file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+        beginEvent();
+        m_file << "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":" << ProcessId << ",\"args\":{\"name\":\"Renderer\"}}";
+        beginEvent();
+        m_file << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":" << ProcessId << ",\"tid\":" << FrameTrack << ",\"args\":{\"name\":\"Frames\"}}";
+    }
+
+    ChromeTrace::~ChromeTrace()
+    {
+        m_file << "\n]}\n";
+    }
+
+    void ChromeTrace::addFrame(const FrameProfile &profile)
+    {
+        std::lock_guard<std::mutex> lk(m_mutex);
+
+        if (!m_origin)
+            m_origin = profile.start;
+
+        std::string args = "\"index\":" + std::to_string(m_frames++) + ",\"cancelled\":" + (profile.cancelled ? "true" : "false") +
+                           ",\"allocations\":" + std::to_string(profile.getAllocations());
+        writeSpan(profile.cancelled ? "Frame (cancelled)" : "Frame", FrameTrack, profile.start, profile.end, args);
+
+        for (auto &&[thread, tasks] : profile.tasks)
+        {
+            size_t track = getTrack(thread);
+            for (auto &&task : tasks)
+                writeSpan(task.Label, track, task.start, task.end, task.allocations ? "\"allocations\":" + std::to_string(task.allocations) : "");
+        }
+
+        // Counters hold their value until the next frame sets them again
+        for (auto &&[name, value] : profile.counters)
+        {
+            beginEvent();
+            m_file << "{\"ph\":\"C\",\"name\":";
+            writeString(m_file, name);
+            m_file << ",\"pid\":" << ProcessId << ",\"ts\":" << (profile.end - *m_origin).count() << ",\"args\":{\"value\":" << value << "}}";
+        }
+        m_file.flush();
+    }
+
+    size_t ChromeTrace::getTrack(std::thread::id thread)
+    {
+        auto found = m_threads.find(thread);
+        if (found != m_threads.end())
+            return found->second;
+
+        size_t track = m_threads.size() + 1;
+        m_threads.emplace(thread, track);
+
+        beginEvent();
+        m_file << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":" << ProcessId << ",\"tid\":" << track << ",\"args\":{\"name\":\"Thread " << track << "\"}}";
+        return track;
+    }
+
+    void ChromeTrace::beginEvent()
+    {
+        if (!m_firstEvent)
+            m_file << ',';
+        m_firstEvent = false;
+        m_file << "\n";
+    }
+
+    void ChromeTrace::writeSpan(const char *name, size_t track, time_point start, time_point end, const std::string &args)
+    {
+        beginEvent();
+        m_file << "{\"ph\":\"X\",\"name\":";
+        writeString(m_file, name);
+        m_file << ",\"pid\":" << ProcessId << ",\"tid\":" << track << ",\"ts\":" << (start - *m_origin).count()
+               << ",\"dur\":" << std::max<int64_t>((end - start).count(), 0) << ",\"args\":{" << args << "}}";
+    }
+}
@@ -0,0 +1,721 @@
+#include <compiled_scene.h>
+
+#include <cpu_dispatch.h>
+#include <ray_stats.h>
+
+#include <algorithm>
+#include <typeinfo>
+
+namespace rt
+{
+    template <typename T>
+    using SphereBucket = typename BasicCompiledScene<T>::SphereBucket;
+    template <typename T>
+    using PlaneBucket = typename BasicCompiledScene<T>::PlaneBucket;
+    template <typename T>
+    using CubeBucket = typename BasicCompiledScene<T>::CubeBucket;
+
+    // Same as in SceneShape::intersect, closer hits are rejected to avoid self intersections of secondary rays
+    static constexpr double MinHitDistance = 0.01;
+
+    static constexpr uint32_t NoHit = UINT32_MAX;
+
+    // ---------- Kernels ----------
+    // All kernels are kept branch free, so the loops can be vectorized
+
+    template <typename T>
+    static inline void intersectPlanes(const PlaneBucket<T> &planes, const m::ray<T> &ray, T &tNearest, uint32_t &nearest)
+    {
+        for (uint32_t i = 0; i < planes.shapes.size(); i++)
+        {
+            T o = planes.rowX[i] * ray.origin.x + planes.rowY[i] * ray.origin.y + planes.rowZ[i] * ray.origin.z + planes.rowW[i];
+            T d = planes.rowX[i] * ray.direction.x + planes.rowY[i] * ray.direction.y + planes.rowZ[i] * ray.direction.z;
+            T t = -o / d;
+
+            bool hit = t >= T(MinHitDistance) && t < tNearest;
+            tNearest = hit ? t : tNearest;
+            nearest = hit ? i : nearest;
+        }
+    }
+
+    template <typename T>
+    static inline void intersectSpheres(const SphereBucket<T> &spheres, uint32_t first, uint32_t count, const m::ray<T> &ray, T &tNearest, uint32_t &nearest)
+    {
+        T a = m::dot(ray.direction, ray.direction);
+        for (uint32_t i = first; i < first + count; i++)
+        {
+            T ox = ray.origin.x - spheres.centerX[i];
+            T oy = ray.origin.y - spheres.centerY[i];
+            T oz = ray.origin.z - spheres.centerZ[i];
+
+            T b = 2 * (ox * ray.direction.x + oy * ray.direction.y + oz * ray.direction.z);
+            T c = ox * ox + oy * oy + oz * oz - spheres.radius2[i];
+
+            T result = b * b - 4 * a * c;
+            T t = (-b - std::sqrt(std::max(result, T(0)))) / (2 * a);
+
+            bool hit = result >= 0 && t >= T(MinHitDistance) && t < tNearest;
+            tNearest = hit ? t : tNearest;
+            nearest = hit ? i : nearest;
+        }
+    }
+
+    // Slab test of the ray against the unit cube in local space of cube i, returns the entry and exit ray parameters
+    template <typename T>
+    static inline void cubeSlabs(const CubeBucket<T> &cubes, uint32_t i, const m::vec3<T> &origin, const m::vec3<T> &direction, T &tEnter, T &tExit)
+    {
+        auto &inverse = cubes.inverse;
+
+        tEnter = -INFINITY;
+        tExit = INFINITY;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            const size_t row = axis * 4;
+
+            T o = inverse[row][i] * origin.x + inverse[row + 1][i] * origin.y + inverse[row + 2][i] * origin.z + inverse[row + 3][i];
+            T d = inverse[row][i] * direction.x + inverse[row + 1][i] * direction.y + inverse[row + 2][i] * direction.z;
+
+            T invDirection = T(1) / d;
+            T t0 = (T(-0.5) - o) * invDirection;
+            T t1 = (T(0.5) - o) * invDirection;
+            tEnter = std::max(tEnter, std::min(t0, t1));
+            tExit = std::min(tExit, std::max(t0, t1));
+        }
+    }
+
+    template <typename T>
+    static inline void intersectCubes(const CubeBucket<T> &cubes, uint32_t first, uint32_t count, const m::ray<T> &ray, T &tNearest, uint32_t &nearest)
+    {
+        for (uint32_t i = first; i < first + count; i++)
+        {
+            T tEnter, tExit;
+            cubeSlabs<T>(cubes, i, ray.origin, ray.direction, tEnter, tExit);
+
+            bool hit = tEnter <= tExit && tEnter > T(MinHitDistance) && tEnter < tNearest;
+            tNearest = hit ? tEnter : tNearest;
+            nearest = hit ? i : nearest;
+        }
+    }
+
+    // Stores the hit of lane i, if it is in front of the current one
+    template <typename T>
+    static inline void updatePacketHit(BasicPacketHits<T> &hits, size_t i, bool hit, T t, const SceneShape *shape, const Transform::Cached *transform)
+    {
+        hit = hit && t < hits.t[i];
+        hits.t[i] = hit ? t : hits.t[i];
+        hits.object[i] = hit ? shape : hits.object[i];
+        hits.transform[i] = hit ? transform : hits.transform[i];
+        hits.hasIntersection[i] = hit ? false : hits.hasIntersection[i];
+    }
+
+    template <typename T>
+    static inline void planePacketKernelBody(const PlaneBucket<T> &planes, const BasicRayPacket<T> &packet, BasicPacketHits<T> &hits)
+    {
+        for (uint32_t p = 0; p < planes.shapes.size(); p++)
+            for (size_t i = 0; i < packet.size; i++)
+            {
+                T o = planes.rowX[p] * packet.originX[i] + planes.rowY[p] * packet.originY[i] + planes.rowZ[p] * packet.originZ[i] + planes.rowW[p];
+                T d = planes.rowX[p] * packet.directionX[i] + planes.rowY[p] * packet.directionY[i] + planes.rowZ[p] * packet.directionZ[i];
+                T t = -o / d;
+
+                updatePacketHit<T>(hits, i, t >= T(MinHitDistance), t, planes.shapes[p], &planes.transforms[p]);
+            }
+    }
+
+    RT_KERNEL_TEMPLATE(void, planePacketKernel, T, (const PlaneBucket<T> &planes, const BasicRayPacket<T> &packet, BasicPacketHits<T> &hits), (planes, packet, hits))
+
+    template <typename T>
+    static inline void spherePacketKernelBody(const SphereBucket<T> &spheres, uint32_t first, uint32_t count, const BasicRayPacket<T> &packet, BasicPacketHits<T> &hits)
+    {
+        for (uint32_t s = first; s < first + count; s++)
+            for (size_t i = 0; i < packet.size; i++)
+            {
+                T ox = packet.originX[i] - spheres.centerX[s];
+                T oy = packet.originY[i] - spheres.centerY[s];
+                T oz = packet.originZ[i] - spheres.centerZ[s];
+                T dx = packet.directionX[i], dy = packet.directionY[i], dz = packet.directionZ[i];
+
+                T a = dx * dx + dy * dy + dz * dz;
+                T b = 2 * (ox * dx + oy * dy + oz * dz);
+                T c = ox * ox + oy * oy + oz * oz - spheres.radius2[s];
+
+                T result = b * b - 4 * a * c;
+                T t = (-b - std::sqrt(std::max(result, T(0)))) / (2 * a);
+
+                updatePacketHit<T>(hits, i, result >= 0 && t >= T(MinHitDistance), t, spheres.shapes[s], &spheres.transforms[s]);
+            }
+    }
+
+    RT_KERNEL_TEMPLATE(void, spherePacketKernel, T, (const SphereBucket<T> &spheres, uint32_t first, uint32_t count, const BasicRayPacket<T> &packet, BasicPacketHits<T> &hits),
+                       (spheres, first, count, packet, hits))
+
+    template <typename T>
+    static inline void cubePacketKernelBody(const CubeBucket<T> &cubes, uint32_t first, uint32_t count, const BasicRayPacket<T> &packet, BasicPacketHits<T> &hits)
+    {
+        for (uint32_t c = first; c < first + count; c++)
+            for (size_t i = 0; i < packet.size; i++)
+            {
+                T tEnter, tExit;
+                cubeSlabs<T>(cubes, c, m::vec3<T>(packet.originX[i], packet.originY[i], packet.originZ[i]),
+                             m::vec3<T>(packet.directionX[i], packet.directionY[i], packet.directionZ[i]), tEnter, tExit);
+
+                updatePacketHit<T>(hits, i, tEnter <= tExit && tEnter > T(MinHitDistance), tEnter, cubes.shapes[c], &cubes.transforms[c]);
+            }
+    }
+
+    RT_KERNEL_TEMPLATE(void, cubePacketKernel, T, (const CubeBucket<T> &cubes, uint32_t first, uint32_t count, const BasicRayPacket<T> &packet, BasicPacketHits<T> &hits),
+                       (cubes, first, count, packet, hits))
+
+    // ---------- Building ----------
+
+    // Spheres can only be stored by center and radius, if their transform keeps them round
+    static inline bool hasUniformScale(const m::dmat4 &matrix, double &scale)
+    {
+        m::dvec3 x(matrix[0]), y(matrix[1]), z(matrix[2]);
+
+        double scale2 = m::length2(x);
+        double epsilon = 1e-9 * scale2;
+
+        scale = std::sqrt(scale2);
+        return std::abs(m::length2(y) - scale2) <= epsilon && std::abs(m::length2(z) - scale2) <= epsilon &&
+               std::abs(m::dot(x, y)) <= epsilon && std::abs(m::dot(y, z)) <= epsilon && std::abs(m::dot(z, x)) <= epsilon;
+    }
+
+    // World space bounds of a sphere with uniform scale, false if it can't be stored in the sphere bucket
+    static inline bool getSphereBounds(const Shapes::Sphere *sphere, m::AABB<double> &bounds)
+    {
+        auto  &mats = sphere->transform.cached;
+        double scale;
+        if (!hasUniformScale(mats.matrix, scale))
+            return false;
+
+        double   radius = std::abs(sphere->radius) * scale;
+        m::dvec3 center(mats.matrix[3]);
+        bounds = m::AABB<double>(center - m::dvec3(radius), center + m::dvec3(radius));
+        return true;
+    }
+
+    // The setters below store the compiled data of a single shape at position i of its bucket,
+    // they are shared by build and refit
+
+    template <typename T>
+    static inline void setPlane(PlaneBucket<T> &planes, size_t i, const SceneShape *shape)
+    {
+        auto &inverse = shape->transform.cached.inverseMatrix;
+        planes.rowX[i] = T(inverse[0][1]);
+        planes.rowY[i] = T(inverse[1][1]);
+        planes.rowZ[i] = T(inverse[2][1]);
+        planes.rowW[i] = T(inverse[3][1]);
+        planes.shapes[i] = shape;
+        planes.transforms[i] = shape->transform.cached;
+        planes.revisions[i] = shape->getRevision();
+    }
+
+    template <typename T>
+    static inline void setSphere(SphereBucket<T> &spheres, size_t i, const Shapes::Sphere *sphere, const m::AABB<double> &bounds)
+    {
+        m::dvec3 center = bounds.getCenter();
+        double   radius = bounds.max.x - center.x;
+        spheres.centerX[i] = T(center.x);
+        spheres.centerY[i] = T(center.y);
+        spheres.centerZ[i] = T(center.z);
+        spheres.radius2[i] = T(radius * radius);
+        spheres.shapes[i] = sphere;
+        spheres.transforms[i] = sphere->transform.cached;
+        spheres.revisions[i] = sphere->getRevision();
+    }
+
+    template <typename T>
+    static inline void setCube(CubeBucket<T> &cubes, size_t i, const SceneShape *cube)
+    {
+        auto &inverse = cube->transform.cached.inverseMatrix;
+        for (int row = 0; row < 3; row++)
+            for (int column = 0; column < 4; column++)
+                cubes.inverse[row * 4 + column][i] = T(inverse[column][row]);
+        cubes.shapes[i] = cube;
+        cubes.transforms[i] = cube->transform.cached;
+        cubes.revisions[i] = cube->getRevision();
+    }
+
+    template <typename T>
+    void BasicCompiledScene<T>::clear()
+    {
+        m_spheres = SphereBucket();
+        m_planes = PlaneBucket();
+        m_cubes = CubeBucket();
+        m_voxels = VoxelBucket();
+        m_generic = GenericBucket();
+        m_pendingVoxels.clear();
+        m_structureRevision = UINT64_MAX;
+    }
+
+    template <typename T>
+    void BasicCompiledScene<T>::build(const std::vector<std::shared_ptr<SceneShape>> &shapes, uint64_t structureRevision)
+    {
+        clear();
+        m_structureRevision = structureRevision;
+
+        // Indices into shapes per bucket
+        std::vector<uint32_t>        planes;
+        std::vector<uint32_t>        spheres;
+        std::vector<m::AABB<double>> sphereBounds;
+        std::vector<uint32_t>        cubes;
+        std::vector<m::AABB<double>> cubeBounds;
+        std::vector<uint32_t>        voxels;
+        std::vector<m::AABB<double>> voxelBounds;
+        std::vector<uint32_t>        generic;
+        std::vector<m::AABB<double>> genericBounds;
+
+        for (uint32_t s = 0; s < shapes.size(); s++)
+        {
+            auto &shape = shapes[s];
+            auto &type = typeid(*shape);
+
+            m::AABB<double> bounds;
+            if (type == typeid(Shapes::Plane))
+                planes.push_back(s);
+            else if (type == typeid(Shapes::Sphere) && getSphereBounds((const Shapes::Sphere *)shape.get(), bounds))
+            {
+                spheres.push_back(s);
+                sphereBounds.push_back(bounds);
+            }
+            else if (type == typeid(Shapes::Cube))
+            {
+                cubes.push_back(s);
+                cubeBounds.push_back(*shape->getBounds());
+            }
+            else if (type == typeid(Shapes::VoxelShape))
+            {
+                // Grids, that are not loaded yet, can't be hit. The scene is rebuilt once they are.
+                if (((const Shapes::VoxelShape *)shape.get())->grid)
+                {
+                    voxels.push_back(s);
+                    voxelBounds.push_back(*shape->getBounds());
+                }
+                else
+                    m_pendingVoxels.push_back(s);
+            }
+            else if (auto bounds = shape->getBounds())
+            {
+                generic.push_back(s);
+                genericBounds.push_back(*bounds);
+            }
+            else
+            {
+                m_generic.unbounded.push_back(shape.get());
+                m_generic.unboundedTransforms.push_back(shape->transform.cached);
+                m_generic.unboundedSources.push_back(s);
+            }
+        }
+
+        auto resize = [](auto &bucket, size_t size)
+        {
+            bucket.shapes.resize(size);
+            bucket.transforms.resize(size);
+            bucket.revisions.resize(size);
+            bucket.sources.resize(size);
+        };
+
+        resize(m_planes, planes.size());
+        m_planes.rowX.resize(planes.size());
+        m_planes.rowY.resize(planes.size());
+        m_planes.rowZ.resize(planes.size());
+        m_planes.rowW.resize(planes.size());
+        for (size_t i = 0; i < planes.size(); i++)
+        {
+            m_planes.sources[i] = planes[i];
+            setPlane<T>(m_planes, i, shapes[planes[i]].get());
+        }
+
+        // The arrays are filled in BVH order, so every leaf is a contiguous range of them
+        m_spheres.bvh.build(sphereBounds);
+        resize(m_spheres, spheres.size());
+        m_spheres.centerX.resize(spheres.size());
+        m_spheres.centerY.resize(spheres.size());
+        m_spheres.centerZ.resize(spheres.size());
+        m_spheres.radius2.resize(spheres.size());
+        for (size_t i = 0; i < spheres.size(); i++)
+        {
+            uint32_t index = m_spheres.bvh.getIndices()[i];
+            m_spheres.sources[i] = spheres[index];
+            setSphere<T>(m_spheres, i, (const Shapes::Sphere *)shapes[spheres[index]].get(), sphereBounds[index]);
+        }
+
+        m_cubes.bvh.build(cubeBounds);
+        resize(m_cubes, cubes.size());
+        for (auto &&row : m_cubes.inverse)
+            row.resize(cubes.size());
+        for (size_t i = 0; i < cubes.size(); i++)
+        {
+            m_cubes.sources[i] = cubes[m_cubes.bvh.getIndices()[i]];
+            setCube<T>(m_cubes, i, shapes[m_cubes.sources[i]].get());
+        }
+
+        m_voxels.bvh.build(voxelBounds);
+        for (uint32_t index : m_voxels.bvh.getIndices())
+        {
+            auto *shape = (const Shapes::VoxelShape *)shapes[voxels[index]].get();
+            m_voxels.shapes.push_back(shape);
+            m_voxels.transforms.push_back(shape->transform.cached);
+            m_voxels.revisions.push_back(shape->getRevision());
+            m_voxels.sources.push_back(voxels[index]);
+        }
+
+        m_generic.bvh.build(genericBounds);
+        for (uint32_t index : m_generic.bvh.getIndices())
+        {
+            const SceneShape *shape = shapes[generic[index]].get();
+            m_generic.shapes.push_back(shape);
+            m_generic.transforms.push_back(shape->transform.cached);
+            m_generic.revisions.push_back(shape->getRevision());
+            m_generic.sources.push_back(generic[index]);
+        }
+    }
+
+    template <typename T>
+    bool BasicCompiledScene<T>::refit(const std::vector<std::shared_ptr<SceneShape>> &shapes)
+    {
+        for (uint32_t index : m_pendingVoxels)
+            if (((const Shapes::VoxelShape *)shapes[index].get())->grid)
+                return false;
+
+        // The shapes may be other copies of the same objects, the revisions tell whether they changed
+        auto rebind = [&](auto &bucket)
+        {
+            using shape_type = typename std::remove_reference_t<decltype(bucket.shapes)>::value_type;
+            for (size_t i = 0; i < bucket.shapes.size(); i++)
+                bucket.shapes[i] = static_cast<shape_type>(shapes[bucket.sources[i]].get());
+        };
+        rebind(m_planes);
+        rebind(m_spheres);
+        rebind(m_cubes);
+        rebind(m_voxels);
+        rebind(m_generic);
+        for (size_t i = 0; i < m_generic.unbounded.size(); i++)
+            m_generic.unbounded[i] = shapes[m_generic.unboundedSources[i]].get();
+
+        for (size_t i = 0; i < m_planes.shapes.size(); i++)
+            if (m_planes.revisions[i] != m_planes.shapes[i]->getRevision())
+                setPlane<T>(m_planes, i, m_planes.shapes[i]);
+
+        // Only the data of changed shapes is updated, the BVHs are refit if any of their shapes changed.
+        // A shape, that doesn't fit into its bucket anymore, needs a rebuild.
+        bool changed = false;
+        for (uint32_t i = 0; i < m_spheres.shapes.size(); i++)
+        {
+            auto *sphere = (const Shapes::Sphere *)m_spheres.shapes[i];
+            if (m_spheres.revisions[i] == sphere->getRevision())
+                continue;
+
+            m::AABB<double> bounds;
+            if (!getSphereBounds(sphere, bounds))
+                return false;
+            setSphere<T>(m_spheres, i, sphere, bounds);
+            m_spheres.bvh.setBounds(i, bounds);
+            changed = true;
+        }
+        if (changed)
+            m_spheres.bvh.refit();
+
+        changed = false;
+        for (uint32_t i = 0; i < m_cubes.shapes.size(); i++)
+        {
+            const SceneShape *cube = m_cubes.shapes[i];
+            if (m_cubes.revisions[i] == cube->getRevision())
+                continue;
+
+            setCube<T>(m_cubes, i, cube);
+            m_cubes.bvh.setBounds(i, *cube->getBounds());
+            changed = true;
+        }
+        if (changed)
+            m_cubes.bvh.refit();
+
+        changed = false;
+        for (uint32_t i = 0; i < m_voxels.shapes.size(); i++)
+        {
+            const Shapes::VoxelShape *shape = m_voxels.shapes[i];
+            if (m_voxels.revisions[i] == shape->getRevision())
+                continue;
+            if (!shape->grid)
+                return false;
+
+            m_voxels.bvh.setBounds(i, *shape->getBounds());
+            m_voxels.transforms[i] = shape->transform.cached;
+            m_voxels.revisions[i] = shape->getRevision();
+            changed = true;
+        }
+        if (changed)
+            m_voxels.bvh.refit();
+
+        changed = false;
+        for (uint32_t i = 0; i < m_generic.shapes.size(); i++)
+        {
+            const SceneShape *shape = m_generic.shapes[i];
+            if (m_generic.revisions[i] == shape->getRevision())
+                continue;
+
+            auto bounds = shape->getBounds();
+            if (!bounds)
+                return false;
+            m_generic.bvh.setBounds(i, *bounds);
+            m_generic.transforms[i] = shape->transform.cached;
+            m_generic.revisions[i] = shape->getRevision();
+            changed = true;
+        }
+        if (changed)
+            m_generic.bvh.refit();
+
+        // There are only a few of them, e.g. planes with custom shapes
+        for (size_t i = 0; i < m_generic.unbounded.size(); i++)
+            m_generic.unboundedTransforms[i] = m_generic.unbounded[i]->transform.cached;
+
+        return true;
+    }
+
+    // ---------- Queries ----------
+
+    // Transforms intersection details from local object space back to world space
+    static inline void toWorldSpace(Intersection &intersection, const Transform::Cached &mats)
+    {
+        intersection.position = mats.matrix * m::dvec4(intersection.position, 1.0);
+        intersection.normal = mats.inverseTransposeMatrix * m::dvec4(intersection.normal, 0.0);
+    }
+
+    template <typename T>
+    std::optional<Intersection> BasicCompiledScene<T>::resolve(const m::ray<T> &ray, const SceneShape *object, const Transform::Cached &transform,
+                                                               const std::optional<Intersection> &intersection) const
+    {
+        // The specialized buckets only know the ray parameter, so the nearest shape is intersected once more for the details
+        std::optional<Intersection> result = intersection ? intersection : object->intersect(transform.inverseMatrix * m::ray<double>(ray));
+        if (!result)
+            return std::nullopt;
+
+        toWorldSpace(*result, transform);
+        return result;
+    }
+
+    template <typename T>
+    std::optional<Intersection> BasicCompiledScene<T>::castRay(const m::ray<T> &ray, T tMax) const
+    {
+        Hit hit{.t = tMax};
+
+        // Tests are counted per leaf, not per shape, so the kernels stay branch free
+        RayStats::count(RayStats::PlaneTests, m_planes.shapes.size());
+        uint32_t nearest = NoHit;
+        intersectPlanes<T>(m_planes, ray, hit.t, nearest);
+        if (nearest != NoHit)
+        {
+            hit.object = m_planes.shapes[nearest];
+            hit.transform = &m_planes.transforms[nearest];
+        }
+
+        // Every node behind the nearest hit found so far is culled
+        nearest = NoHit;
+        m_spheres.bvh.traverseLeaves(ray, hit.t, [&](uint32_t first, uint32_t count)
+                                     {
+                                         RayStats::count(RayStats::SphereTests, count);
+                                         intersectSpheres<T>(m_spheres, first, count, ray, hit.t, nearest);
+                                         return false; });
+        if (nearest != NoHit)
+        {
+            hit.object = m_spheres.shapes[nearest];
+            hit.transform = &m_spheres.transforms[nearest];
+        }
+
+        nearest = NoHit;
+        m_cubes.bvh.traverseLeaves(ray, hit.t, [&](uint32_t first, uint32_t count)
+                                   {
+                                       RayStats::count(RayStats::CubeTests, count);
+                                       intersectCubes<T>(m_cubes, first, count, ray, hit.t, nearest);
+                                       return false; });
+        if (nearest != NoHit)
+        {
+            hit.object = m_cubes.shapes[nearest];
+            hit.transform = &m_cubes.transforms[nearest];
+        }
+
+        // Generic shapes are always intersected in double precision
+        m::ray<double> doubleRay(ray);
+
+        auto testGeneric = [&](const SceneShape *shape, const Transform::Cached &transform)
+        {
+            RayStats::count(RayStats::GenericTests);
+            auto intersection = shape->intersect(transform.inverseMatrix * doubleRay);
+            if (intersection && intersection->t < hit.t)
+            {
+                hit.t = T(intersection->t);
+                hit.object = shape;
+                hit.transform = &transform;
+                hit.intersection = intersection;
+            }
+        };
+
+        for (size_t i = 0; i < m_generic.unbounded.size(); i++)
+            testGeneric(m_generic.unbounded[i], m_generic.unboundedTransforms[i]);
+        m_generic.bvh.traverseLeaves(ray, hit.t, [&](uint32_t first, uint32_t count)
+                                     {
+                                         for (uint32_t i = first; i < first + count; i++)
+                                             testGeneric(m_generic.shapes[i], m_generic.transforms[i]);
+                                         return false; });
+
+        // The grid traversal of an instance stops at the nearest hit found so far
+        m_voxels.bvh.traverseLeaves(ray, hit.t, [&](uint32_t first, uint32_t count)
+                                    {
+                                        RayStats::count(RayStats::VoxelTests, count);
+                                        for (uint32_t i = first; i < first + count; i++)
+                                        {
+                                            const Shapes::VoxelShape *shape = m_voxels.shapes[i];
+                                            auto intersection = shape->intersect(m_voxels.transforms[i].inverseMatrix * doubleRay, double(hit.t));
+                                            if (intersection && intersection->t < hit.t)
+                                            {
+                                                hit.t = T(intersection->t);
+                                                hit.object = shape;
+                                                hit.transform = &m_voxels.transforms[i];
+                                                hit.intersection = intersection;
+                                            }
+                                        }
+                                        return false; });
+
+        if (!hit.object)
+            return std::nullopt;
+        return resolve(ray, hit.object, *hit.transform, hit.intersection);
+    }
+
+    template <typename T>
+    bool BasicCompiledScene<T>::occluded(const m::ray<T> &ray, T tMax) const
+    {
+        // Any hit before tMax is enough, the traversal stops at the first one
+        T        t = tMax;
+        uint32_t nearest = NoHit;
+
+        RayStats::count(RayStats::PlaneTests, m_planes.shapes.size());
+        intersectPlanes<T>(m_planes, ray, t, nearest);
+        if (nearest != NoHit)
+            return true;
+
+        m_spheres.bvh.traverseLeaves(ray, t, [&](uint32_t first, uint32_t count)
+                                     {
+                                         RayStats::count(RayStats::SphereTests, count);
+                                         intersectSpheres<T>(m_spheres, first, count, ray, t, nearest);
+                                         return nearest != NoHit; });
+        if (nearest != NoHit)
+            return true;
+
+        m_cubes.bvh.traverseLeaves(ray, t, [&](uint32_t first, uint32_t count)
+                                   {
+                                       RayStats::count(RayStats::CubeTests, count);
+                                       intersectCubes<T>(m_cubes, first, count, ray, t, nearest);
+                                       return nearest != NoHit; });
+        if (nearest != NoHit)
+            return true;
+
+        m::ray<double> doubleRay(ray);
+        RayStats::count(RayStats::GenericTests, m_generic.unbounded.size());
+        for (size_t i = 0; i < m_generic.unbounded.size(); i++)
+            if (m_generic.unbounded[i]->occludes(m_generic.unboundedTransforms[i].inverseMatrix * doubleRay, tMax))
+                return true;
+
+        bool hit = false;
+        m_generic.bvh.traverseLeaves(ray, t, [&](uint32_t first, uint32_t count)
+                                     {
+                                         for (uint32_t i = first; i < first + count && !hit; i++)
+                                         {
+                                             const SceneShape *shape = m_generic.shapes[i];
+                                             RayStats::count(RayStats::GenericTests);
+                                             hit = shape->occludes(m_generic.transforms[i].inverseMatrix * doubleRay, tMax);
+                                         }
+                                         return hit; });
+        if (hit)
+            return true;
+
+        m_voxels.bvh.traverseLeaves(ray, t, [&](uint32_t first, uint32_t count)
+                                    {
+                                        for (uint32_t i = first; i < first + count && !hit; i++)
+                                        {
+                                            const Shapes::VoxelShape *shape = m_voxels.shapes[i];
+                                            RayStats::count(RayStats::VoxelTests);
+                                            hit = shape->occludes(m_voxels.transforms[i].inverseMatrix * doubleRay, tMax);
+                                        }
+                                        return hit; });
+        return hit;
+    }
+
+    template <typename T>
+    void BasicCompiledScene<T>::castPacket(const BasicRayPacket<T> &packet, BasicPacketHits<T> &hits) const
+    {
+        // Every lane of the packet is tested, even the ones, that are already behind a closer hit
+        RayStats::count(RayStats::PlaneTests, m_planes.shapes.size() * packet.size);
+        planePacketKernel<T>(m_planes, packet, hits);
+
+        m_spheres.bvh.traversePacketLeaves(packet, hits.t, [&](uint32_t first, uint32_t count)
+                                           {
+                                               RayStats::count(RayStats::SphereTests, count * packet.size);
+                                               spherePacketKernel<T>(m_spheres, first, count, packet, hits); });
+        m_cubes.bvh.traversePacketLeaves(packet, hits.t, [&](uint32_t first, uint32_t count)
+                                         {
+                                             RayStats::count(RayStats::CubeTests, count * packet.size);
+                                             cubePacketKernel<T>(m_cubes, first, count, packet, hits); });
+
+        // Generic shapes are intersected lane by lane, their full intersection is kept so it is not computed twice
+        auto testGeneric = [&](const SceneShape *shape, const Transform::Cached &transform)
+        {
+            RayStats::count(RayStats::GenericTests, packet.size);
+            for (size_t i = 0; i < packet.size; i++)
+            {
+                auto intersection = shape->intersect(transform.inverseMatrix * m::ray<double>(packet[i]));
+                if (intersection && intersection->t < hits.t[i])
+                {
+                    hits.t[i] = T(intersection->t);
+                    hits.object[i] = shape;
+                    hits.transform[i] = &transform;
+                    hits.hasIntersection[i] = true;
+                    hits.intersections[i] = *intersection;
+                }
+            }
+        };
+
+        for (size_t i = 0; i < m_generic.unbounded.size(); i++)
+            testGeneric(m_generic.unbounded[i], m_generic.unboundedTransforms[i]);
+        m_generic.bvh.traversePacketLeaves(packet, hits.t, [&](uint32_t first, uint32_t count)
+                                           {
+                                               for (uint32_t i = first; i < first + count; i++)
+                                                   testGeneric(m_generic.shapes[i], m_generic.transforms[i]); });
+
+        m_voxels.bvh.traversePacketLeaves(packet, hits.t, [&](uint32_t first, uint32_t count)
+                                          {
+                                              RayStats::count(RayStats::VoxelTests, count * packet.size);
+                                              for (uint32_t v = first; v < first + count; v++)
+                                              {
+                                                  const Shapes::VoxelShape *shape = m_voxels.shapes[v];
+                                                  auto &inverse = m_voxels.transforms[v].inverseMatrix;
+                                                  for (size_t i = 0; i < packet.size; i++)
+                                                  {
+                                                      auto intersection = shape->intersect(inverse * m::ray<double>(packet[i]), double(hits.t[i]));
+                                                      if (intersection && intersection->t < hits.t[i])
+                                                      {
+                                                          hits.t[i] = T(intersection->t);
+                                                          hits.object[i] = shape;
+                                                          hits.transform[i] = &m_voxels.transforms[v];
+                                                          hits.hasIntersection[i] = true;
+                                                          hits.intersections[i] = *intersection;
+                                                      }
+                                                  }
+                                              } });
+    }
+
+    template <typename T>
+    std::optional<Intersection> BasicCompiledScene<T>::resolvePacketHit(const BasicRayPacket<T> &packet, const BasicPacketHits<T> &hits, size_t i) const
+    {
+        if (!hits.object[i])
+            return std::nullopt;
+
+        std::optional<Intersection> intersection;
+        if (hits.hasIntersection[i])
+            intersection = hits.intersections[i];
+        return resolve(packet[i], hits.object[i], *hits.transform[i], intersection);
+    }
+
+    template class BasicCompiledScene<float>;
+    template class BasicCompiledScene<double>;
+} // namespace rt
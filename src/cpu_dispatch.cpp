@@ -0,0 +1,55 @@
+#include <cpu_dispatch.h>
+
+#include <stdexcept>
+#include <string>
+
+namespace rt
+{
+    namespace CpuDispatch
+    {
+        static Isa selectedIsa = Isa::Generic;
+
+        const char *isaToString(Isa isa)
+        {
+            switch (isa)
+            {
+            case Isa::AVX2:
+                return "avx2";
+            case Isa::AVX512:
+                return "avx512";
+            default:
+                return "generic";
+            }
+        }
+
+        std::optional<Isa> isaFromString(std::string_view name)
+        {
+            for (size_t i = 0; i < (size_t)Isa::Isa_COUNT; i++)
+                if (name == isaToString((Isa)i))
+                    return (Isa)i;
+            return std::nullopt;
+        }
+
+        Isa detectIsa()
+        {
+#ifdef RT_CPU_DISPATCH
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq") && __builtin_cpu_supports("avx512vl"))
+                return Isa::AVX512;
+            if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+                return Isa::AVX2;
+#endif
+            return Isa::Generic;
+        }
+
+        void selectIsa(std::optional<Isa> forced)
+        {
+            Isa detected = detectIsa();
+            if (forced && *forced > detected)
+                throw std::runtime_error(std::string("Instruction set ") + isaToString(*forced) + " is not supported, best supported: " + isaToString(detected));
+            selectedIsa = forced.value_or(detected);
+        }
+
+        Isa getIsa() { return selectedIsa; }
+    } // namespace CpuDispatch
+} // namespace rt
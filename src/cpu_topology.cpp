@@ -0,0 +1,255 @@
+#include <cpu_topology.h>
+
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <set>
+#include <string>
+#include <thread>
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace rt
+{
+    namespace CpuTopology
+    {
+        // Parses the cpu lists of /sys, e.g. "0-3,8-11"
+        static std::vector<int> parseCpuList(const std::string &list)
+        {
+            std::vector<int> cpus;
+            size_t           start = 0;
+            while (start < list.size())
+            {
+                size_t      end = std::min(list.find(',', start), list.size());
+                std::string range = list.substr(start, end - start);
+                start = end + 1;
+
+                size_t dash = range.find('-');
+                try
+                {
+                    int first = std::stoi(range.substr(0, dash));
+                    int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+                    for (int cpu = first; cpu <= last; cpu++)
+                        cpus.push_back(cpu);
+                }
+                catch (const std::exception &)
+                {
+                }
+            }
+            return cpus;
+        }
+
+        static std::optional<std::string> readLine(const std::filesystem::path &path)
+        {
+            std::ifstream file(path);
+            std::string   line;
+            if (!file || !std::getline(file, line))
+                return std::nullopt;
+            return line;
+        }
+
+        static std::optional<int> readInt(const std::filesystem::path &path)
+        {
+            auto line = readLine(path);
+            if (!line)
+                return std::nullopt;
+            try
+            {
+                return std::stoi(*line);
+            }
+            catch (const std::exception &)
+            {
+                return std::nullopt;
+            }
+        }
+
+        static Topology flatTopology()
+        {
+            Topology topology;
+            int      count = std::max<int>(std::thread::hardware_concurrency(), 1);
+            for (int i = 0; i < count; i++)
+                topology.cpus.push_back({.id = i, .core = i, .package = 0, .node = 0});
+            return topology;
+        }
+
+        static Topology detectTopology()
+        {
+            const std::filesystem::path cpuDir("/sys/devices/system/cpu");
+            const std::filesystem::path nodeDir("/sys/devices/system/node");
+
+            auto online = readLine(cpuDir / "online");
+            if (!online)
+                return flatTopology();
+
+            // NUMA node of every cpu, cpus without a node end up on the first one
+            std::map<int, int> nodeOfCpu;
+            std::set<int>      nodeIds;
+            std::error_code    error;
+            for (auto &&entry : std::filesystem::directory_iterator(nodeDir, error))
+            {
+                std::string name = entry.path().filename().string();
+                if (name.rfind("node", 0) != 0 || name.size() == 4 || !std::all_of(name.begin() + 4, name.end(), ::isdigit))
+                    continue;
+
+                int node = std::stoi(name.substr(4));
+                if (auto list = readLine(entry.path() / "cpulist"))
+                    for (int cpu : parseCpuList(*list))
+                        nodeOfCpu[cpu] = node;
+            }
+
+            Topology topology;
+            for (int id : parseCpuList(*online))
+            {
+                auto topologyDir = cpuDir / ("cpu" + std::to_string(id)) / "topology";
+                int  node = nodeOfCpu.contains(id) ? nodeOfCpu[id] : 0;
+                nodeIds.insert(node);
+                topology.cpus.push_back({
+                    .id = id,
+                    .core = readInt(topologyDir / "core_id").value_or(id),
+                    .package = readInt(topologyDir / "physical_package_id").value_or(0),
+                    .node = (size_t)node,
+                });
+            }
+            if (topology.cpus.empty())
+                return flatTopology();
+
+            // Nodes without online cpus are left out, the others are numbered densely
+            std::map<int, size_t> nodeIndex;
+            for (int node : nodeIds)
+                nodeIndex.emplace(node, nodeIndex.size());
+            for (auto &&cpu : topology.cpus)
+                cpu.node = nodeIndex[(int)cpu.node];
+            topology.nodeCount = nodeIndex.size();
+
+            return topology;
+        }
+
+        const Topology &getTopology()
+        {
+            static const Topology topology =
+#ifdef __linux__
+                detectTopology();
+#else
+                flatTopology();
+#endif
+            return topology;
+        }
+
+        const char *pinningToString(Pinning pinning)
+        {
+            switch (pinning)
+            {
+            case Pinning::Cores:
+                return "cores";
+            case Pinning::Nodes:
+                return "nodes";
+            default:
+                return "none";
+            }
+        }
+
+        std::optional<Pinning> pinningFromString(std::string_view name)
+        {
+            for (size_t i = 0; i < (size_t)Pinning::Pinning_COUNT; i++)
+                if (name == pinningToString((Pinning)i))
+                    return (Pinning)i;
+            return std::nullopt;
+        }
+
+        // Whether the process may run on the cpu, e.g. it may be restricted by taskset or a cgroup
+        static bool isAllowed(int cpu)
+        {
+#ifdef __linux__
+            static const std::optional<cpu_set_t> allowed = []() -> std::optional<cpu_set_t>
+            {
+                cpu_set_t set;
+                CPU_ZERO(&set);
+                if (sched_getaffinity(0, sizeof(set), &set) != 0)
+                    return std::nullopt;
+                return set;
+            }();
+            return !allowed || cpu >= CPU_SETSIZE || CPU_ISSET(cpu, &*allowed);
+#else
+            return true;
+#endif
+        }
+
+        std::vector<WorkerPlacement> placeWorkers(const PlacementOptions &options)
+        {
+            const Topology &topology = getTopology();
+
+            // Usable cpus of every node, the first cpu of every core comes before the SMT siblings
+            std::vector<std::vector<int>> nodeCpus(topology.nodeCount);
+            std::set<std::pair<int, int>> cores;
+            std::vector<const Cpu *>      siblings;
+            for (auto &&cpu : topology.cpus)
+            {
+                if (!isAllowed(cpu.id))
+                    continue;
+                if (cores.emplace(cpu.package, cpu.core).second)
+                    nodeCpus[cpu.node].push_back(cpu.id);
+                else if (options.useSmt)
+                    siblings.push_back(&cpu);
+            }
+            for (auto &&cpu : siblings)
+                nodeCpus[cpu->node].push_back(cpu->id);
+
+            // Nodes with usable cpus, the others are kept in nodeCpus, so placements refer to the nodes of the topology
+            std::vector<size_t> nodes;
+            size_t              usable = 0;
+            for (size_t node = 0; node < nodeCpus.size(); node++)
+            {
+                if (!nodeCpus[node].empty())
+                    nodes.push_back(node);
+                usable += nodeCpus[node].size();
+            }
+            size_t threadCount = options.threadCount != 0 ? options.threadCount : std::max<size_t>(usable, 1);
+
+            std::vector<WorkerPlacement> placement(threadCount);
+            if (options.pinning == Pinning::None || nodes.empty())
+                return placement;
+
+            // Round robin over the nodes, so a node only gets a second worker once every node has one
+            for (size_t i = 0; i < threadCount; i++)
+            {
+                size_t node = nodes[i % nodes.size()];
+                auto  &cpus = nodeCpus[node];
+                placement[i].node = node;
+                if (options.pinning == Pinning::Cores)
+                    placement[i].cpus = {cpus[i / nodes.size() % cpus.size()]};
+                else
+                    placement[i].cpus = cpus;
+            }
+            return placement;
+        }
+
+        bool pinCurrentThread(const std::vector<int> &cpus)
+        {
+            if (cpus.empty())
+                return true;
+#if defined(_WIN32)
+            DWORD_PTR mask = 0;
+            for (int cpu : cpus)
+                if (cpu < 8 * (int)sizeof(DWORD_PTR))
+                    mask |= (DWORD_PTR)1 << cpu;
+            return mask != 0 && SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+#elif defined(__linux__)
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            for (int cpu : cpus)
+                if (cpu < CPU_SETSIZE)
+                    CPU_SET(cpu, &set);
+            return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+            return true;
+#endif
+        }
+    } // namespace CpuTopology
+} // namespace rt
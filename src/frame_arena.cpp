@@ -0,0 +1,80 @@
+#include <frame_arena.h>
+
+#include <algorithm>
+
+namespace rt
+{
+    FrameArena::Scope::Scope(FrameArena &arena)
+        : m_arena(arena), m_block(arena.m_block), m_offset(arena.m_offset)
+    {
+        m_arena.m_depth++;
+    }
+
+    FrameArena::Scope::~Scope()
+    {
+        m_arena.m_depth--;
+        m_arena.m_block = m_block;
+        m_arena.m_offset = m_offset;
+    }
+
+    FrameArena &FrameArena::local()
+    {
+        thread_local FrameArena arena;
+        uint64_t                frame = s_frame.load(std::memory_order_relaxed);
+        // Frames may be traced concurrently, e.g. by render jobs, so a scope can be open when the next one starts
+        if (arena.m_frame != frame && arena.m_depth == 0)
+        {
+            arena.reset();
+            arena.m_frame = frame;
+        }
+        return arena;
+    }
+
+    void FrameArena::nextFrame()
+    {
+        s_frame.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void *FrameArena::allocate(size_t size, size_t alignment)
+    {
+        while (m_block < m_blocks.size())
+        {
+            auto  &block = m_blocks[m_block];
+            size_t offset = (m_offset + alignment - 1) & ~(alignment - 1);
+            if (offset + size <= block.size)
+            {
+                m_offset = offset + size;
+                return block.data.get() + offset;
+            }
+            m_block++;
+            m_offset = 0;
+        }
+
+        // Blocks grow geometrically, so a frame needs only a few of them until the next reset merges them
+        size_t blockSize = std::max({MinBlockSize, size + alignment, m_blocks.empty() ? 0 : 2 * m_blocks.back().size});
+        m_blocks.push_back({std::make_unique_for_overwrite<std::byte[]>(blockSize), blockSize});
+        m_block = m_blocks.size() - 1;
+        m_offset = 0;
+        return allocate(size, alignment);
+    }
+
+    void FrameArena::reset()
+    {
+        if (m_blocks.size() > 1)
+        {
+            size_t capacity = getCapacity();
+            m_blocks.clear();
+            m_blocks.push_back({std::make_unique_for_overwrite<std::byte[]>(capacity), capacity});
+        }
+        m_block = 0;
+        m_offset = 0;
+    }
+
+    size_t FrameArena::getCapacity() const
+    {
+        size_t capacity = 0;
+        for (auto &&block : m_blocks)
+            capacity += block.size;
+        return capacity;
+    }
+}
@@ -0,0 +1,87 @@
+#include <frame_pipeline.h>
+#include <profiler.h>
+
+namespace rt
+{
+    std::future<void> FramePipeline::submit(WorkStealingPool<Renderer::task_type> &threadPool, std::function<void()> function)
+    {
+        Renderer::task_type task(std::move(function));
+        auto                future = task.get_future();
+        threadPool << std::move(task);
+        return future;
+    }
+
+    void FramePipeline::run(WorkStealingPool<Renderer::task_type> &threadPool)
+    {
+        auto prepare = [](FrameContext *frame)
+        {
+            Profiling::profiler.profileTask("Prepare Frame");
+            frame->renderer->prepareFrame(*frame);
+            Profiling::profiler.endTask();
+        };
+        auto boundary = [this]
+        {
+            if (frameBoundary)
+                frameBoundary();
+        };
+
+        std::unique_ptr<FrameContext> current = next(true);
+        if (!current)
+            return;
+        boundary();
+        current->slot = m_nextSlot++ % Scene::FrameSlots;
+        prepare(current.get());
+
+        // Post-processing of the previous frame, only one runs at a time so frames are presented in order
+        std::future<void> posted;
+
+        while (current)
+        {
+            // The next frame is prepared while this one is traced, if it is known already
+            std::unique_ptr<FrameContext> following = next(false);
+            std::future<void>             prepared;
+            if (following)
+            {
+                boundary();
+                following->slot = m_nextSlot++ % Scene::FrameSlots;
+                prepared = submit(threadPool, [&prepare, frame = following.get()]
+                                  { prepare(frame); });
+            }
+
+            if (beforeTrace)
+                beforeTrace(*current);
+            bool finished = current->renderer->traceFrame(*current);
+            if (afterTrace)
+                afterTrace(*current, finished);
+
+            if (finished)
+            {
+                if (posted.valid())
+                    posted.get();
+                // The task owns the frame from here on, it is post-processed while the next frame is traced
+                posted = submit(threadPool, [this, frame = current.release()]
+                                {
+                                    Profiling::profiler.profileTask("Post Process");
+                                    frame->renderer->postProcess(*frame);
+                                    Profiling::profiler.endTask();
+                                    if (present)
+                                        present(std::unique_ptr<FrameContext>(frame));
+                                    else
+                                        delete frame; });
+            }
+
+            if (following)
+                prepared.get();
+            else if ((following = next(true)))
+            {
+                boundary();
+                following->slot = m_nextSlot++ % Scene::FrameSlots;
+                prepare(following.get());
+            }
+            current = std::move(following);
+        }
+
+        if (posted.valid())
+            posted.get();
+    }
+}
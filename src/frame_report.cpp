@@ -0,0 +1,188 @@
+#include <profiler.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <map>
+
+#include <imgui.h>
+
+namespace Profiling
+{
+    // Labels of the spans of Renderer::render
+    static constexpr const char *TileLabel = "Render Tile";
+    static constexpr const char *SchedulingLabel = "Scheduling";
+
+    static inline bool hasLabel(const Task &task, const char *label)
+    {
+        return task.Label == label || std::strcmp(task.Label, label) == 0;
+    }
+
+    static inline double toMilliseconds(duration time) { return time.count() / 1000.0; }
+
+    // Value below which the given fraction of the sorted times lies, by nearest rank
+    static inline double percentile(const std::vector<double> &sorted, double fraction)
+    {
+        size_t rank = (size_t)std::ceil(fraction * sorted.size());
+        return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+    }
+
+    FrameReport::FrameReport(size_t window)
+        : m_window(std::max<size_t>(window, 1)) {}
+
+    void FrameReport::addFrame(const FrameProfile &profile)
+    {
+        Frame &frame = m_frames.emplace_back();
+        frame.time = profile.end - profile.start;
+
+        for (auto &&[thread, tasks] : profile.tasks)
+        {
+            ThreadUtilisation utilisation{.thread = thread};
+            duration          spans = duration::zero();
+            for (size_t i = 0; i < tasks.size(); i++)
+            {
+                // Tasks of the previous frame may reach into this one, only the part within the frame counts
+                auto &task = tasks[i];
+                auto  time = std::max(std::min(task.end, profile.end) - std::max(task.start, profile.start), duration::zero());
+
+                if (hasLabel(task, SchedulingLabel))
+                {
+                    // The span after the last tile of a thread lasts until the frame ends, that is waiting for the other threads
+                    if (i + 1 < tasks.size() && hasLabel(tasks[i + 1], TileLabel))
+                    {
+                        utilisation.scheduling += time;
+                        utilisation.dequeues++;
+                        spans += time;
+                    }
+                    continue;
+                }
+
+                if (hasLabel(task, TileLabel))
+                    utilisation.tiles++;
+                utilisation.busy += time;
+                spans += time;
+            }
+            utilisation.idle = std::max(frame.time - spans, duration::zero());
+            frame.threads.push_back(utilisation);
+        }
+
+        while (m_frames.size() > m_window)
+            m_frames.pop_front();
+    }
+
+    void FrameReport::clear()
+    {
+        m_frames.clear();
+    }
+
+    FrameReport::Summary FrameReport::getSummary() const
+    {
+        Summary summary;
+        summary.frames = m_frames.size();
+        if (m_frames.empty())
+            return summary;
+
+        std::vector<double> times;
+        times.reserve(m_frames.size());
+
+        // Threads in the order they first appear in the window
+        std::map<std::thread::id, size_t> threadIndices;
+        duration                          threadTime = duration::zero();
+        duration                          busy = duration::zero();
+        duration                          scheduling = duration::zero();
+        size_t                            dequeues = 0;
+        for (auto &&frame : m_frames)
+        {
+            times.push_back(toMilliseconds(frame.time));
+            for (auto &&thread : frame.threads)
+            {
+                auto [found, inserted] = threadIndices.emplace(thread.thread, summary.threads.size());
+                if (inserted)
+                    summary.threads.push_back({.thread = thread.thread});
+
+                auto &total = summary.threads[found->second];
+                total.busy += thread.busy;
+                total.scheduling += thread.scheduling;
+                total.idle += thread.idle;
+                total.tiles += thread.tiles;
+                total.dequeues += thread.dequeues;
+
+                threadTime += frame.time;
+                busy += thread.busy;
+                scheduling += thread.scheduling;
+                dequeues += thread.dequeues;
+            }
+        }
+
+        std::sort(times.begin(), times.end());
+        for (double time : times)
+            summary.mean += time;
+        summary.mean /= times.size();
+        summary.p50 = percentile(times, 0.50);
+        summary.p95 = percentile(times, 0.95);
+        summary.p99 = percentile(times, 0.99);
+        summary.max = times.back();
+
+        if (threadTime > duration::zero())
+            summary.utilisation = (double)busy.count() / threadTime.count();
+        if (dequeues != 0)
+            summary.schedulingPerTile = toMilliseconds(scheduling) / dequeues;
+        return summary;
+    }
+
+    std::ostream &operator<<(std::ostream &stream, const FrameReport::Summary &summary)
+    {
+        stream << "Frames: " << summary.frames << ", mean " << summary.mean << " ms, p50 " << summary.p50 << " ms, p95 " << summary.p95
+               << " ms, p99 " << summary.p99 << " ms, max " << summary.max << " ms\n"
+               << "Utilisation: " << 100 * summary.utilisation << "%, scheduling " << 1000 * summary.schedulingPerTile << " us per tile\n";
+        for (size_t i = 0; i < summary.threads.size(); i++)
+        {
+            auto &thread = summary.threads[i];
+            stream << "Thread " << i << ": busy " << toMilliseconds(thread.busy) << " ms, scheduling " << toMilliseconds(thread.scheduling)
+                   << " ms, idle " << toMilliseconds(thread.idle) << " ms, " << thread.tiles << " tiles\n";
+        }
+        return stream;
+    }
+
+    void writeJson(std::ostream &stream, const FrameReport::Summary &summary)
+    {
+        stream << "{\"frames\": " << summary.frames << ", \"meanMs\": " << summary.mean << ", \"p50Ms\": " << summary.p50
+               << ", \"p95Ms\": " << summary.p95 << ", \"p99Ms\": " << summary.p99 << ", \"maxMs\": " << summary.max
+               << ", \"utilisation\": " << summary.utilisation << ", \"schedulingPerTileMs\": " << summary.schedulingPerTile << ", \"threads\": [";
+        for (size_t i = 0; i < summary.threads.size(); i++)
+        {
+            auto &thread = summary.threads[i];
+            stream << (i == 0 ? "" : ", ") << "{\"busyMs\": " << toMilliseconds(thread.busy) << ", \"schedulingMs\": " << toMilliseconds(thread.scheduling)
+                   << ", \"idleMs\": " << toMilliseconds(thread.idle) << ", \"tiles\": " << thread.tiles << "}";
+        }
+        stream << "]}";
+    }
+} // namespace Profiling
+
+namespace rtImGui
+{
+    void drawFrameReport(const Profiling::FrameReport::Summary &summary)
+    {
+        ImGui::Text("Last %zu frames: p50 %.2f ms, p95 %.2f ms, p99 %.2f ms, max %.2f ms", summary.frames, summary.p50, summary.p95, summary.p99, summary.max);
+        ImGui::Text("Utilisation: %.1f%%, scheduling %.2f us per tile", 100 * summary.utilisation, 1000 * summary.schedulingPerTile);
+
+        if (summary.threads.empty() || !ImGui::TreeNode("Threads"))
+            return;
+
+        // Busy, scheduling and idle share of every thread
+        for (size_t i = 0; i < summary.threads.size(); i++)
+        {
+            auto  &thread = summary.threads[i];
+            double total = (double)(thread.busy + thread.scheduling + thread.idle).count();
+            float  busy = total > 0 ? (float)(thread.busy.count() / total) : 0.0f;
+
+            char overlay[64];
+            snprintf(overlay, sizeof(overlay), "%.1f%% busy, %.1f%% scheduling", 100 * busy, total > 0 ? 100 * thread.scheduling.count() / total : 0.0);
+            ImGui::Text("Thread %zu", i);
+            ImGui::SameLine();
+            ImGui::ProgressBar(busy, ImVec2(-1, 0), overlay);
+        }
+        ImGui::TreePop();
+    }
+} // namespace rtImGui
@@ -2,7 +2,11 @@
 #include <iostream>
 
 #include <application.h>
+#include <chrome_trace.h>
+#include <cpu_dispatch.h>
+#include <cpu_topology.h>
 #include <filesystem>
+#include <pool_benchmark.h>
 #include <stdlib.h>
 #include <tclap/CmdLine.h>
 #include <window.h>
@@ -13,6 +17,17 @@ struct Args
     std::optional<std::string> sceneFile;
     std::optional<std::string> output;
     rt::m::u64vec2             size;
+    std::optional<std::string> isa;
+    std::optional<size_t>      benchmarkFrames;
+    std::optional<size_t>      poolBenchmarkThreads;
+    std::optional<size_t>      loaderThreads;
+    std::optional<std::string> trace;
+    std::optional<std::string> stats;
+    std::optional<std::string> report;
+
+    rt::RenderParams::Heatmap heatmap;
+
+    rt::CpuTopology::PlacementOptions placement;
 
     static Args parse(int argc, const char *const *argv)
     {
@@ -24,6 +39,30 @@ struct Args
         TCLAP::ValueArg<int64_t>     heightArg("", "height", "Height of the output", false, 1080, "int", cmd);
         TCLAP::ValueArg<std::string> outputArg("o", "output", "Output file", false, "", "string", cmd);
 
+        std::vector<std::string>             isaNames = {"generic", "avx2", "avx512"};
+        TCLAP::ValuesConstraint<std::string> isaConstraint(isaNames);
+        TCLAP::ValueArg<std::string>         isaArg("", "isa", "Force the instruction set of the render kernels, detected from the CPU by default", false, "", &isaConstraint, cmd);
+
+        TCLAP::ValueArg<int64_t> benchmarkArg("", "benchmark", "Render every scene in resource/scenes with every renderer the given number of times and print the frame times", false, 5, "int", cmd);
+
+        TCLAP::ValueArg<int64_t> poolBenchmarkArg("", "pool-benchmark", "Compare the scaling of the thread pools from 1 to the given number of threads and exit", false, 0, "int", cmd);
+
+        TCLAP::ValueArg<int64_t> loaderThreadsArg("", "loader-threads", "Number of background threads loading and decoding resources, a quarter of the cores by default", false, 1, "int", cmd);
+
+        std::vector<std::string>             heatmapNames = {"off", "tile-time", "tile-rays", "pixel-cycles"};
+        TCLAP::ValuesConstraint<std::string> heatmapConstraint(heatmapNames);
+        TCLAP::ValueArg<std::string>         heatmapArg("", "heatmap", "Write a false colour heatmap of the render cost next to the output as <name>.heatmap.jpg", false, "off", &heatmapConstraint, cmd);
+
+        TCLAP::ValueArg<std::string> statsArg("", "stats", "Write the ray statistics of all rendered frames on exit, as JSON for .json files and as CSV otherwise", false, "", "file", cmd);
+        TCLAP::ValueArg<std::string> reportArg("", "report", "Write frame time percentiles and the utilisation of the threads as JSON at the end of headless and benchmark runs", false, "", "file.json", cmd);
+        TCLAP::ValueArg<std::string> traceArg("", "trace", "Write the profiles of all frames to a file in the Chrome Trace Event format, e.g. for chrome://tracing or Perfetto", false, "", "file.json", cmd);
+
+        TCLAP::ValueArg<int64_t>             threadsArg("", "threads", "Number of render threads, one per usable cpu by default", false, 0, "int", cmd);
+        std::vector<std::string>             pinningNames = {"none", "cores", "nodes"};
+        TCLAP::ValuesConstraint<std::string> pinningConstraint(pinningNames);
+        TCLAP::ValueArg<std::string>         pinArg("", "pin", "Bind every render thread to a core or to the cpus of a NUMA node, the threads are spread over the nodes and each node renders its own region", false, "none", &pinningConstraint, cmd);
+        TCLAP::SwitchArg                     noSmtArg("", "no-smt", "Use only one logical cpu per core for the render threads", cmd, false);
+
         cmd.parse(argc, argv);
 
         return Args{
@@ -31,6 +70,19 @@ struct Args
             .sceneFile = sceneArg.isSet() ? std::optional(sceneArg.getValue()) : std::nullopt,
             .output = outputArg.isSet() ? std::optional(outputArg.getValue()) : std::nullopt,
             .size = {widthArg.getValue(), heightArg.getValue()},
+            .isa = isaArg.isSet() ? std::optional(isaArg.getValue()) : std::nullopt,
+            .benchmarkFrames = benchmarkArg.isSet() ? std::optional((size_t)std::max<int64_t>(benchmarkArg.getValue(), 1)) : std::nullopt,
+            .poolBenchmarkThreads = poolBenchmarkArg.isSet() ? std::optional((size_t)std::max<int64_t>(poolBenchmarkArg.getValue(), 1)) : std::nullopt,
+            .loaderThreads = loaderThreadsArg.isSet() ? std::optional((size_t)std::max<int64_t>(loaderThreadsArg.getValue(), 1)) : std::nullopt,
+            .trace = traceArg.isSet() ? std::optional(traceArg.getValue()) : std::nullopt,
+            .stats = statsArg.isSet() ? std::optional(statsArg.getValue()) : std::nullopt,
+            .report = reportArg.isSet() ? std::optional(reportArg.getValue()) : std::nullopt,
+            .heatmap = (rt::RenderParams::Heatmap)(std::find(heatmapNames.begin(), heatmapNames.end(), heatmapArg.getValue()) - heatmapNames.begin()),
+            .placement = {
+                .threadCount = (size_t)std::max<int64_t>(threadsArg.getValue(), 0),
+                .pinning = rt::CpuTopology::pinningFromString(pinArg.getValue()).value_or(rt::CpuTopology::Pinning::None),
+                .useSmt = !noSmtArg.getValue(),
+            },
         };
     }
 };
@@ -43,8 +95,42 @@ int main(int argc, char const *argv[])
 
     try
     {
-        rt::Application application(originPath, args.useGui, args.sceneFile, args.output, args.size);
-        application.run();
+        rt::CpuDispatch::selectIsa(args.isa ? rt::CpuDispatch::isaFromString(*args.isa) : std::nullopt);
+
+        if (args.poolBenchmarkThreads)
+        {
+            rt::benchmarkThreadPools(*args.poolBenchmarkThreads);
+            return 0;
+        }
+
+        // Outlives the application, so every frame ends up in the trace
+        std::optional<Profiling::ChromeTrace> trace;
+        if (args.trace)
+        {
+            trace.emplace(*args.trace);
+            Profiling::profiler.onFrame = [&](const Profiling::FrameProfile &profile)
+            { trace->addFrame(profile); };
+        }
+
+        {
+            rt::Application application(originPath, args.useGui && !args.benchmarkFrames, args.sceneFile, args.output, args.size, args.loaderThreads, args.placement);
+            application.outputHeatmap = args.heatmap;
+            if (args.report)
+                application.reportPath = *args.report;
+            if (args.benchmarkFrames)
+                application.benchmark(*args.benchmarkFrames);
+            else
+                application.run();
+        }
+        Profiling::profiler.onFrame = nullptr;
+
+        if (args.stats)
+        {
+            rt::RayStats rayStats;
+            double       traceTime;
+            uint64_t     frames = rt::RayStats::getTotal(rayStats, traceTime);
+            rt::writeRayStatsSummary(*args.stats, rayStats, frames, traceTime);
+        }
     }
     catch (const std::exception &e)
     {
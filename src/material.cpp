@@ -3,6 +3,7 @@
 #include <scene/scene.h>
 #include <rt_renderer.h>
 #include <pixel_logger.h>
+#include <frame_arena.h>
 #include <rt_imgui.h>
 
 namespace rt
@@ -58,7 +59,10 @@ namespace rt
             }
             PIXEL_LOGGER_LOG("Reflection: ", e_reflection, "\n");
 
-            std::vector<SceneLight *> i_Lights;
+            // Scratch memory of the shading point, released once it is shaded
+            FrameArena               &arena = FrameArena::local();
+            FrameArena::Scope         scratch(arena);
+            FrameVector<SceneLight *> i_Lights(arena);
             i_Lights.reserve(scene.lights.size());
             for (auto &&light : scene.lights)
             {
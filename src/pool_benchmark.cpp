@@ -0,0 +1,144 @@
+#include <pool_benchmark.h>
+
+#include <thread_pool.h>
+#include <work_stealing_pool.h>
+
+#include <chrono>
+#include <cmath>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace rt
+{
+    using task_type = std::packaged_task<void()>;
+
+    static constexpr size_t FlatTaskCount = 32768;
+    static constexpr size_t NestedOuterCount = 64;
+    static constexpr size_t NestedInnerCount = 512;
+    static constexpr size_t WorkIterations = 2000;
+    static constexpr size_t Repetitions = 5;
+
+    static std::atomic<double> s_sink = 0;
+
+    // Roughly the cost of a few pixels, the result is kept so the loop isn't optimized away
+    static inline void work(size_t seed)
+    {
+        double x = (double)seed;
+        for (size_t i = 0; i < WorkIterations; i++)
+            x = std::sqrt(x * x + 1.0);
+        if (x < 0)
+            s_sink = x;
+    }
+
+    // Submits one task per item and waits for their futures, like Renderer::render
+    template <typename _Pool>
+    static void runFlat(_Pool &pool)
+    {
+        std::vector<std::future<void>> futures;
+        futures.reserve(FlatTaskCount);
+        for (size_t i = 0; i < FlatTaskCount; i++)
+        {
+            task_type task([i]
+                           { work(i); });
+            futures.push_back(task.get_future());
+            pool << std::move(task);
+        }
+        for (auto &&f : futures)
+            f.get();
+    }
+
+    // Same items as runFlat, shared through WorkStealingPool::parallelFor without any tasks
+    static void runLoop(WorkStealingPool<task_type> &pool)
+    {
+        pool.parallelFor(FlatTaskCount, [](size_t i)
+                         { work(i); });
+    }
+
+    // parallelFor inside parallelFor, the inner loops are waited for from pool tasks
+    template <typename _Pool>
+    static void runNested(_Pool &pool)
+    {
+        parallelFor(pool, NestedOuterCount, [&](size_t outer)
+                    { parallelFor(pool, NestedInnerCount, [&](size_t inner)
+                                  { work(outer * NestedInnerCount + inner); }); });
+    }
+
+    // Minimum time of all repetitions in milliseconds, after one warm up run
+    template <typename _Pool, typename F>
+    static double measure(size_t threadCount, F &&workload)
+    {
+        _Pool pool(threadCount);
+
+        workload(pool);
+        double best = INFINITY;
+        for (size_t i = 0; i < Repetitions; i++)
+        {
+            auto start = std::chrono::steady_clock::now();
+            workload(pool);
+            auto end = std::chrono::steady_clock::now();
+            best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+        }
+        return best;
+    }
+
+    void benchmarkThreadPools(size_t maxThreads)
+    {
+        std::vector<size_t> threadCounts;
+        for (size_t count = 1; count < maxThreads; count *= 2)
+            threadCounts.push_back(count);
+        threadCounts.push_back(maxThreads);
+
+        struct Result
+        {
+            size_t threads;
+            double flat[2];
+            double loop;
+            double nested[2];
+        };
+        std::vector<Result> results;
+
+        // The pools print a line when they start, so the table is printed after all runs
+        for (size_t threads : threadCounts)
+        {
+            Result result{.threads = threads};
+            result.flat[0] = measure<ThreadPool<task_type>>(threads, [](auto &pool)
+                                                            { runFlat(pool); });
+            result.flat[1] = measure<WorkStealingPool<task_type>>(threads, [](auto &pool)
+                                                                  { runFlat(pool); });
+            result.loop = measure<WorkStealingPool<task_type>>(threads, [](auto &pool)
+                                                               { runLoop(pool); });
+            result.nested[0] = measure<ThreadPool<task_type>>(threads, [](auto &pool)
+                                                              { runNested(pool); });
+            result.nested[1] = measure<WorkStealingPool<task_type>>(threads, [](auto &pool)
+                                                                    { runNested(pool); });
+            results.push_back(result);
+        }
+
+        std::cout << "\nThread pool scaling, min of " << Repetitions << " runs in ms (speedup over 1 thread)\n"
+                  << "Flat: " << FlatTaskCount << " tasks, nested: " << NestedOuterCount << "x" << NestedInnerCount << " parallelFor\n\n"
+                  << std::setw(8) << "threads" << std::setw(22) << "flat ThreadPool" << std::setw(22) << "flat WorkStealing" << std::setw(22) << "parallelFor"
+                  << std::setw(22) << "nested ThreadPool" << std::setw(22) << "nested WorkStealing" << '\n';
+
+        auto print = [&](double time, double base)
+        {
+            std::ostringstream cell;
+            cell << std::fixed << std::setprecision(2) << time << " (" << std::setprecision(1) << base / time << "x)";
+            std::cout << std::setw(22) << cell.str();
+        };
+
+        const Result &base = results.front();
+        for (auto &&result : results)
+        {
+            std::cout << std::setw(8) << result.threads;
+            for (int pool = 0; pool < 2; pool++)
+                print(result.flat[pool], base.flat[pool]);
+            print(result.loop, base.loop);
+            for (int pool = 0; pool < 2; pool++)
+                print(result.nested[pool], base.nested[pool]);
+            std::cout << '\n';
+        }
+        std::cout << std::flush;
+    }
+} // namespace rt
@@ -2,6 +2,8 @@
 
 #include <rtmath.h>
 
+#include <algorithm>
+
 #define IMGUI_DEFINE_MATH_OPERATORS
 #include <imgui_internal.h>
 
@@ -23,12 +25,28 @@ namespace Profiling
     std::ostream &operator<<(std::ostream &stream, const Task &task)
     {
         return stream << task.Label << ": " << task.getTime().count() / 1000.0 << "ms"
-                      << "\tstart: " << task.start << "\tend: " << task.end;
+                      << "\tstart: " << task.start << "\tend: " << task.end << "\tallocations: " << task.allocations;
+    }
+
+    uint64_t FrameProfile::getAllocations() const
+    {
+        uint64_t allocations = 0;
+        for (auto &&thread : tasks)
+            for (auto &&task : thread.second)
+                allocations += task.allocations;
+        return allocations;
     }
 
     std::ostream &operator<<(std::ostream &stream, const FrameProfile &profile)
     {
         stream << "Start: " << profile.start << "\nEnd: " << profile.end << "\nDuration: " << profile.end - profile.start << "\n";
+        stream << "Allocations: " << profile.getAllocations() << "\n";
+        if (profile.cancelled)
+            stream << "Cancelled\n";
+        if (profile.cancelledFrames)
+            stream << "Cancelled before: " << profile.cancelledFrames << " frames, " << profile.cancelledTime << "\n";
+        for (auto &&[name, value] : profile.counters)
+            stream << name << ": " << value << "\n";
         for (auto &&thread : profile.tasks)
         {
             stream << "Thread " << thread.first << ":\n";
@@ -46,6 +64,18 @@ namespace Profiling
         return std::move(currentProfile);
     }
 
+    FrameReport::Summary Profiler::getReport()
+    {
+        std::lock_guard<std::mutex> lk(profileMutex);
+        return report.getSummary();
+    }
+
+    void Profiler::clearReport()
+    {
+        std::lock_guard<std::mutex> lk(profileMutex);
+        report.clear();
+    }
+
     void Profiler::beginFrame()
     {
         if (!enabled)
@@ -54,9 +84,15 @@ namespace Profiling
         std::lock_guard<std::mutex> lk(profileMutex);
         currentProfile = std::make_unique<FrameProfile>();
         currentProfile->start = std::chrono::time_point_cast<duration>(std::chrono::high_resolution_clock::now());
+        currentProfile->cancelledFrames = cancelledFrames;
+        currentProfile->cancelledTime = cancelledTime;
+
+        // Events recorded before are left out of the frame
+        for (auto &&buffer : buffers)
+            buffer->frameStart = buffer->head.load(std::memory_order_acquire);
     }
 
-    void Profiler::endFrame()
+    void Profiler::endFrame(bool cancelled)
     {
         if (!enabled)
             return;
@@ -69,48 +105,152 @@ namespace Profiling
             return;
 
         currentProfile->end = time;
-        for (auto &&thread : currentProfile->tasks)
+        mergeEvents(time);
+
+        currentProfile->cancelled = cancelled;
+        if (cancelled)
+        {
+            cancelledFrames++;
+            cancelledTime += time - currentProfile->start;
+        }
+        else
         {
-            if (!thread.second.empty())
-                thread.second.back().end = time;
+            cancelledFrames = 0;
+            cancelledTime = duration::zero();
+            report.addFrame(*currentProfile);
         }
+
+        if (onFrame)
+            onFrame(*currentProfile);
     }
 
-    void Profiler::profileTask(const char *Label)
+    void Profiler::mergeEvents(time_point end)
     {
-        if (!enabled)
-            return;
+        struct Event
+        {
+            const char *label;
+            int64_t     time;
+            uint64_t    allocations;
+        };
+        std::vector<Event> events;
 
-        auto time = std::chrono::time_point_cast<duration>(std::chrono::high_resolution_clock::now());
+        for (auto &&buffer : buffers)
+        {
+            uint64_t head = buffer->head.load(std::memory_order_acquire);
+            uint64_t first = std::max(buffer->frameStart, head > ThreadBuffer::Capacity ? head - ThreadBuffer::Capacity : 0);
 
-        std::lock_guard<std::mutex> lk(profileMutex);
+            events.clear();
+            for (uint64_t i = first; i < head; i++)
+            {
+                auto &event = buffer->events[i % ThreadBuffer::Capacity];
+                events.push_back({event.label.load(std::memory_order_relaxed), event.time.load(std::memory_order_relaxed), event.allocations.load(std::memory_order_relaxed)});
+            }
 
-        if (currentProfile == nullptr)
-            return;
+            // Slots the thread wrote again while they were copied are dropped
+            uint64_t written = buffer->head.load(std::memory_order_acquire);
+            size_t   overwritten = written > ThreadBuffer::Capacity + first ? std::min<size_t>(written - ThreadBuffer::Capacity - first, events.size()) : 0;
+            buffer->frameStart = head;
+            if (events.size() == overwritten)
+                continue;
+
+            auto    &threadTasks = currentProfile->tasks[buffer->thread];
+            uint64_t allocationsAtStart = 0;
+            bool     open = false;
+            for (size_t i = overwritten; i < events.size(); i++)
+            {
+                auto &event = events[i];
+                auto  eventTime = time_point(duration(event.time));
+                if (open)
+                {
+                    threadTasks.back().end = eventTime;
+                    threadTasks.back().allocations = event.allocations - allocationsAtStart;
+                    open = false;
+                }
+                if (event.label != nullptr)
+                {
+                    threadTasks.emplace_back(event.label, eventTime);
+                    allocationsAtStart = event.allocations;
+                    open = true;
+                }
+            }
+            if (open)
+                threadTasks.back().end = end;
+        }
+    }
 
-        auto &threadTasks = currentProfile->tasks[std::this_thread::get_id()];
+    Profiler::ThreadBuffer &Profiler::registerThread()
+    {
+        std::lock_guard<std::mutex> lk(profileMutex);
+        auto                       &buffer = buffers.emplace_back(std::make_unique<ThreadBuffer>());
+        buffer->thread = std::this_thread::get_id();
+        t_buffer = buffer.get();
+        t_owner = this;
+        return *buffer;
+    }
 
-        if (!threadTasks.empty() && threadTasks.back().end.time_since_epoch() == time_point::duration::zero())
-            threadTasks.back().end = time;
+    void Profiler::record(const char *label)
+    {
+        ThreadBuffer &buffer = t_owner == this ? *t_buffer : registerThread();
+
+        uint64_t head = buffer.head.load(std::memory_order_relaxed);
+        auto    &event = buffer.events[head % ThreadBuffer::Capacity];
+        event.label.store(label, std::memory_order_relaxed);
+        event.time.store(std::chrono::time_point_cast<duration>(std::chrono::high_resolution_clock::now()).time_since_epoch().count(), std::memory_order_relaxed);
+        event.allocations.store(getThreadAllocations(), std::memory_order_relaxed);
+        // Publishes the event to endFrame
+        buffer.head.store(head + 1, std::memory_order_release);
+    }
 
-        threadTasks.emplace_back(Label, time);
+    void Profiler::profileTask(const char *Label)
+    {
+        if (!enabled.load(std::memory_order_relaxed))
+            return;
+        record(Label);
     }
 
     void Profiler::endTask()
     {
-        if (!enabled)
+        if (!enabled.load(std::memory_order_relaxed))
             return;
+        record(nullptr);
+    }
 
-        auto time = std::chrono::time_point_cast<duration>(std::chrono::high_resolution_clock::now());
+    void Profiler::setCounter(const char *name, double value)
+    {
+        if (!enabled)
+            return;
 
         std::lock_guard<std::mutex> lk(profileMutex);
 
         if (currentProfile == nullptr)
             return;
 
-        auto &threadTasks = currentProfile->tasks[std::this_thread::get_id()];
-        if (!threadTasks.empty())
-            threadTasks.back().end = time;
+        for (auto &&counter : currentProfile->counters)
+            if (counter.first == name)
+            {
+                counter.second = value;
+                return;
+            }
+        currentProfile->counters.emplace_back(name, value);
+    }
+
+    double Profiler::measureOverhead(size_t events)
+    {
+        bool wasEnabled = enabled.exchange(true);
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < events; i += 2)
+        {
+            profileTask("Overhead");
+            endTask();
+        }
+        auto end = std::chrono::steady_clock::now();
+        enabled = wasEnabled;
+
+        // The events are recorded outside of any frame, so the next frame leaves them out
+        std::lock_guard<std::mutex> lk(profileMutex);
+        t_buffer->frameStart = t_buffer->head.load(std::memory_order_relaxed);
+
+        return std::chrono::duration<double, std::nano>(end - start).count() / std::max<size_t>(events / 2 * 2, 1);
     }
 
     Profiler profiler;
@@ -151,6 +291,30 @@ namespace rtImGui
     {
         ImGuiWindow *window = ImGui::GetCurrentWindow();
 
+        ImGui::Text("Allocations: %llu", (unsigned long long)profile.getAllocations());
+        height -= ImGui::GetTextLineHeightWithSpacing();
+
+        if (!profile.counters.empty())
+        {
+            float start = ImGui::GetCursorPosY();
+            if (ImGui::TreeNode("Counters"))
+            {
+                for (auto &&[name, value] : profile.counters)
+                    ImGui::Text("%s: %.6g", name, value);
+                ImGui::TreePop();
+            }
+            height -= ImGui::GetCursorPosY() - start;
+        }
+
+        if (profile.cancelled || profile.cancelledFrames)
+        {
+            if (profile.cancelled)
+                ImGui::Text("Cancelled");
+            else
+                ImGui::Text("Cancelled before: %zu frames, %.2f ms", profile.cancelledFrames, profile.cancelledTime.count() / 1000.0);
+            height -= ImGui::GetTextLineHeightWithSpacing();
+        }
+
         ImGui::PushStyleVar(ImGuiStyleVar_WindowPadding, ImVec2(0, 0));
         ImGui::BeginChild(label, ImVec2(window->ContentRegionRect.GetWidth(), height), true, ImGuiWindowFlags_HorizontalScrollbar);
         {
@@ -282,6 +446,8 @@ namespace rtImGui
 
                     std::stringstream ss;
                     ss << task.getTime().count() / 1000.0 << "ms " << task.Label;
+                    if (task.allocations)
+                        ss << " (" << task.allocations << " allocations)";
                     if (p2.x - p1.x > 0 && p2.x > viewport.Min.x && p1.x < viewport.Max.x)
                         drawTaskRect(ImRect(p1, p2), colors[col->second], ss.str().c_str());
                 }
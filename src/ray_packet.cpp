@@ -0,0 +1,75 @@
+#include <ray_packet.h>
+
+#include <cpu_dispatch.h>
+
+namespace rt
+{
+    template <typename T>
+    static inline void transformPacketBody(const BasicRayPacket<T> &packet, const m::mat4<T> &matrix, BasicRayPacket<T> &result)
+    {
+        result.size = packet.size;
+        for (size_t i = 0; i < packet.size; i++)
+        {
+            T ox = packet.originX[i], oy = packet.originY[i], oz = packet.originZ[i];
+            T dx = packet.directionX[i], dy = packet.directionY[i], dz = packet.directionZ[i];
+
+            result.originX[i] = matrix[0][0] * ox + matrix[1][0] * oy + matrix[2][0] * oz + matrix[3][0];
+            result.originY[i] = matrix[0][1] * ox + matrix[1][1] * oy + matrix[2][1] * oz + matrix[3][1];
+            result.originZ[i] = matrix[0][2] * ox + matrix[1][2] * oy + matrix[2][2] * oz + matrix[3][2];
+            result.directionX[i] = matrix[0][0] * dx + matrix[1][0] * dy + matrix[2][0] * dz;
+            result.directionY[i] = matrix[0][1] * dx + matrix[1][1] * dy + matrix[2][1] * dz;
+            result.directionZ[i] = matrix[0][2] * dx + matrix[1][2] * dy + matrix[2][2] * dz;
+        }
+    }
+
+    RT_KERNEL_TEMPLATE(void, transformPacket, T, (const BasicRayPacket<T> &packet, const m::mat4<T> &matrix, BasicRayPacket<T> &result), (packet, matrix, result))
+
+    template <typename T>
+    static inline void generateCameraPacketBody(BasicRayPacket<T> &packet, const T *coordsX, const T *coordsY, size_t size, const m::mat4<T> &inverseCamera)
+    {
+        const m::mat4<T> &c = inverseCamera;
+
+        packet.size = size;
+        for (size_t i = 0; i < size; i++)
+        {
+            T x = coordsX[i], y = coordsY[i];
+
+            // Origin is (x, y, -1, 1) in camera space, the second point on the ray is origin + direction = (x, y, 0, 1)
+            T px = c[0][0] * x + c[1][0] * y + c[3][0];
+            T py = c[0][1] * x + c[1][1] * y + c[3][1];
+            T pz = c[0][2] * x + c[1][2] * y + c[3][2];
+            T pw = c[0][3] * x + c[1][3] * y + c[3][3];
+
+            T originW = T(1) / (pw - c[2][3]);
+            T ox = (px - c[2][0]) * originW;
+            T oy = (py - c[2][1]) * originW;
+            T oz = (pz - c[2][2]) * originW;
+
+            T targetW = T(1) / pw;
+            packet.originX[i] = ox;
+            packet.originY[i] = oy;
+            packet.originZ[i] = oz;
+            packet.directionX[i] = px * targetW - ox;
+            packet.directionY[i] = py * targetW - oy;
+            packet.directionZ[i] = pz * targetW - oz;
+        }
+    }
+
+    RT_KERNEL_TEMPLATE(void, generateCameraPacket, T, (BasicRayPacket<T> &packet, const T *coordsX, const T *coordsY, size_t size, const m::mat4<T> &inverseCamera),
+                       (packet, coordsX, coordsY, size, inverseCamera))
+
+    template <typename T>
+    void BasicRayPacket<T>::transform(const m::mat4<T> &matrix, BasicRayPacket<T> &result) const
+    {
+        transformPacket<T>(*this, matrix, result);
+    }
+
+    template <typename T>
+    void BasicRayPacket<T>::generateCameraRays(const T *coordsX, const T *coordsY, size_t size, const m::mat4<T> &inverseCamera)
+    {
+        generateCameraPacket<T>(*this, coordsX, coordsY, size, inverseCamera);
+    }
+
+    template struct BasicRayPacket<float>;
+    template struct BasicRayPacket<double>;
+} // namespace rt
@@ -0,0 +1,128 @@
+#include <ray_stats.h>
+
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+
+namespace rt
+{
+    static std::mutex s_totalMutex;
+    static RayStats   s_total;
+    static uint64_t   s_totalFrames = 0;
+    static double     s_totalTraceTime = 0;
+
+    const char *rayCounterToString(RayStats::Counter counter)
+    {
+        switch (counter)
+        {
+        case RayStats::PrimaryRays:
+            return "Primary rays";
+        case RayStats::ReflectionRays:
+            return "Reflection rays";
+        case RayStats::ShadowRays:
+            return "Shadow rays";
+        case RayStats::PlaneTests:
+            return "Plane tests";
+        case RayStats::SphereTests:
+            return "Sphere tests";
+        case RayStats::CubeTests:
+            return "Cube tests";
+        case RayStats::VoxelTests:
+            return "Voxel shape tests";
+        case RayStats::GenericTests:
+            return "Generic shape tests";
+        case RayStats::VoxelSteps:
+            return "Voxel steps";
+        case RayStats::TextureSamples:
+            return "Texture samples";
+        default:
+            return "Unknown";
+        }
+    }
+
+    void RayStats::addToTotal(const RayStats &frame, double traceTime)
+    {
+        std::lock_guard lk(s_totalMutex);
+        s_total += frame;
+        s_totalFrames++;
+        s_totalTraceTime += traceTime;
+    }
+
+    uint64_t RayStats::getTotal(RayStats &stats, double &traceTime)
+    {
+        std::lock_guard lk(s_totalMutex);
+        stats = s_total;
+        traceTime = s_totalTraceTime;
+        return s_totalFrames;
+    }
+
+    uint64_t RayStats::getRays() const
+    {
+        return counters[PrimaryRays] + counters[ReflectionRays] + counters[ShadowRays];
+    }
+
+    uint64_t RayStats::getIntersectionTests() const
+    {
+        return counters[PlaneTests] + counters[SphereTests] + counters[CubeTests] + counters[VoxelTests] + counters[GenericTests];
+    }
+
+    RayStats &RayStats::operator+=(const RayStats &other)
+    {
+        for (size_t i = 0; i < Counter_COUNT; i++)
+            counters[i] += other.counters[i];
+        for (size_t i = 0; i < MaxDepth; i++)
+            depths[i] += other.depths[i];
+        return *this;
+    }
+
+    RayStats RayStats::operator-(const RayStats &other) const
+    {
+        RayStats result;
+        for (size_t i = 0; i < Counter_COUNT; i++)
+            result.counters[i] = counters[i] - other.counters[i];
+        for (size_t i = 0; i < MaxDepth; i++)
+            result.depths[i] = depths[i] - other.depths[i];
+        return result;
+    }
+
+    std::ostream &operator<<(std::ostream &stream, const RayStats &stats)
+    {
+        for (size_t i = 0; i < RayStats::Counter_COUNT; i++)
+            stream << rayCounterToString((RayStats::Counter)i) << ": " << stats.counters[i] << "\n";
+        stream << "Recursion depths:";
+        for (uint64_t rays : stats.depths)
+            stream << " " << rays;
+        return stream << "\n";
+    }
+
+    void writeRayStatsSummary(const std::filesystem::path &path, const RayStats &stats, uint64_t frames, double traceTime)
+    {
+        std::ofstream file(path);
+        if (!file)
+            throw std::runtime_error("Could not open statistics file " + path.string());
+
+        if (path.extension() == ".json")
+        {
+            file << "{\n  \"frames\": " << frames << ",\n  \"traceTimeMs\": " << traceTime << ",\n  \"mraysPerSecond\": " << stats.getMraysPerSecond(traceTime)
+                 << ",\n  \"counters\": {";
+            for (size_t i = 0; i < RayStats::Counter_COUNT; i++)
+                file << (i == 0 ? "\n" : ",\n") << "    \"" << rayCounterToString((RayStats::Counter)i) << "\": " << stats.counters[i];
+            file << "\n  },\n  \"recursionDepths\": [";
+            for (size_t i = 0; i < RayStats::MaxDepth; i++)
+                file << (i == 0 ? "" : ", ") << stats.depths[i];
+            file << "]\n}\n";
+        }
+        else
+        {
+            // One statistic per row, the histogram has a row per depth
+            file << "statistic,value\n"
+                 << "Frames," << frames << "\n"
+                 << "Trace time (ms)," << traceTime << "\n"
+                 << "Mrays/s," << stats.getMraysPerSecond(traceTime) << "\n";
+            for (size_t i = 0; i < RayStats::Counter_COUNT; i++)
+                file << rayCounterToString((RayStats::Counter)i) << "," << stats.counters[i] << "\n";
+            for (size_t i = 0; i < RayStats::MaxDepth; i++)
+                file << "Rays at depth " << i << "," << stats.depths[i] << "\n";
+        }
+    }
+} // namespace rt
@@ -0,0 +1,261 @@
+#include <profiler.h>
+#include <render_jobs.h>
+#include <resource_container.h>
+
+#include <algorithm>
+
+namespace rt
+{
+    const char *jobStateToString(RenderJobQueue::JobState state)
+    {
+        switch (state)
+        {
+        case RenderJobQueue::JobState::Queued:
+            return "queued";
+        case RenderJobQueue::JobState::Running:
+            return "running";
+        case RenderJobQueue::JobState::Finished:
+            return "finished";
+        case RenderJobQueue::JobState::Cancelled:
+            return "cancelled";
+        default:
+            return "failed";
+        }
+    }
+
+    // The scene and renderer are released as soon as a job is done, its status is kept until clearDone
+    static void release(RenderJobQueue::Job &job)
+    {
+        job.scene.reset();
+        job.renderer.reset();
+        job.finished = nullptr;
+        job.heatmapFinished = nullptr;
+    }
+
+    RenderJobQueue::RenderJobQueue(WorkStealingPool<Renderer::task_type> *threadPool, ResourceContainer *resources)
+        : m_threadPool(threadPool), m_resources(resources)
+    {
+        m_thread = std::thread(&RenderJobQueue::run, this);
+    }
+
+    RenderJobQueue::~RenderJobQueue()
+    {
+        {
+            std::lock_guard lk(m_mutex);
+            m_terminate = true;
+            for (auto &&entry : m_jobs)
+                entry.cancelled = 1;
+        }
+        m_cv.notify_all();
+        m_thread.join();
+    }
+
+    uint64_t RenderJobQueue::submit(Job job)
+    {
+        uint64_t id;
+        {
+            std::lock_guard lk(m_mutex);
+            id = m_nextId++;
+            auto &entry = m_jobs.emplace_back();
+            entry.id = id;
+            entry.job = std::move(job);
+        }
+        m_cv.notify_all();
+        return id;
+    }
+
+    void RenderJobQueue::cancel(uint64_t id)
+    {
+        {
+            std::lock_guard lk(m_mutex);
+            Entry          *entry = findJob(id);
+            if (entry == nullptr)
+                return;
+            entry->cancelled = 1;
+            if (entry->state == JobState::Queued)
+            {
+                entry->state = JobState::Cancelled;
+                release(entry->job);
+            }
+        }
+        m_cv.notify_all();
+    }
+
+    void RenderJobQueue::clearDone()
+    {
+        std::lock_guard lk(m_mutex);
+        m_jobs.remove_if([](const Entry &entry)
+                         { return entry.state != JobState::Queued && entry.state != JobState::Running; });
+    }
+
+    std::vector<RenderJobQueue::JobStatus> RenderJobQueue::getJobs()
+    {
+        std::lock_guard        lk(m_mutex);
+        std::vector<JobStatus> jobs;
+        jobs.reserve(m_jobs.size());
+        for (auto &&entry : m_jobs)
+            jobs.push_back(getStatus(entry));
+        return jobs;
+    }
+
+    std::optional<RenderJobQueue::JobStatus> RenderJobQueue::getJob(uint64_t id)
+    {
+        std::lock_guard lk(m_mutex);
+        Entry          *entry = findJob(id);
+        if (entry == nullptr)
+            return std::nullopt;
+        return getStatus(*entry);
+    }
+
+    RenderJobQueue::JobStatus RenderJobQueue::waitFor(uint64_t id, std::chrono::milliseconds timeout)
+    {
+        std::unique_lock lk(m_mutex);
+        auto             isDone = [&]
+        {
+            Entry *entry = findJob(id);
+            return entry == nullptr || (entry->state != JobState::Queued && entry->state != JobState::Running);
+        };
+        m_cv.wait_for(lk, timeout, isDone);
+
+        Entry *entry = findJob(id);
+        if (entry == nullptr)
+            return JobStatus{.id = id, .name = "", .priority = 0, .state = JobState::Cancelled};
+        return getStatus(*entry);
+    }
+
+    RenderJobQueue::JobStatus RenderJobQueue::getStatus(const Entry &entry) const
+    {
+        JobStatus status{.id = entry.id, .name = entry.job.name, .priority = entry.job.priority, .state = entry.state, .error = entry.error};
+        switch (entry.state)
+        {
+        case JobState::Running:
+        {
+            status.elapsed = std::chrono::duration<double>(clock::now() - entry.start).count();
+            size_t tileCount = entry.frame ? entry.frame->tileCount.load() : 0;
+            if (tileCount != 0)
+                status.progress = (float)entry.frame->tilesDone.load() / tileCount;
+            // The tiles left are assumed to take as long as the ones so far on average
+            if (status.progress > 0)
+                status.remaining = status.elapsed / status.progress - status.elapsed;
+            break;
+        }
+        case JobState::Finished:
+            status.progress = 1;
+            status.elapsed = std::chrono::duration<double>(entry.end - entry.start).count();
+            status.remaining = 0;
+            break;
+        case JobState::Failed:
+        case JobState::Cancelled:
+            if (entry.start != clock::time_point())
+                status.elapsed = std::chrono::duration<double>(entry.end - entry.start).count();
+            break;
+        default:
+            break;
+        }
+        return status;
+    }
+
+    RenderJobQueue::Entry *RenderJobQueue::findJob(uint64_t id)
+    {
+        auto found = std::find_if(m_jobs.begin(), m_jobs.end(), [id](const Entry &entry)
+                                  { return entry.id == id; });
+        return found == m_jobs.end() ? nullptr : &*found;
+    }
+
+    void RenderJobQueue::run()
+    {
+        while (true)
+        {
+            Entry *next = nullptr;
+            {
+                std::unique_lock lk(m_mutex);
+                m_cv.wait(lk, [&]
+                          { return m_terminate || std::any_of(m_jobs.begin(), m_jobs.end(), [](const Entry &entry)
+                                                              { return entry.state == JobState::Queued; }); });
+                if (m_terminate)
+                    return;
+
+                for (auto &&entry : m_jobs)
+                    if (entry.state == JobState::Queued && (next == nullptr || entry.job.priority > next->job.priority))
+                        next = &entry;
+                next->state = JobState::Running;
+                next->start = clock::now();
+            }
+
+            render(*next);
+            m_cv.notify_all();
+        }
+    }
+
+    void RenderJobQueue::render(Entry &entry)
+    {
+        // Only this thread changes a running job, so the job can be used without the lock
+        Job &job = entry.job;
+
+        FrameBuffer frameBuffer(job.size.x, job.size.y);
+
+        auto frame = std::make_unique<Renderer::FrameContext>();
+        frame->renderer = job.renderer.get();
+        frame->threadPool = m_threadPool;
+        frame->scene = job.scene;
+        frame->frameBuffer = &frameBuffer;
+        frame->renderParams = job.renderParams;
+        frame->cancelToken = CancelToken{.latestFrame = &entry.cancelled, .frame = 0};
+        frame->frame = entry.id;
+        frame->profiled = job.profile;
+
+        {
+            std::lock_guard lk(m_mutex);
+            entry.frame = frame.get();
+        }
+
+        JobState    state = JobState::Cancelled;
+        std::string error;
+        try
+        {
+            if (job.profile)
+                Profiling::profiler.beginFrame();
+            {
+                // The frame boundaries of the render thread fall anywhere into the job, publish skips them while the
+                // scene of the job is compiled. Only the voxel grids, that were loaded by then, are part of the job.
+                std::shared_lock<std::shared_mutex> publishLock;
+                if (m_resources)
+                    publishLock = m_resources->lockPublish();
+                job.renderer->prepareFrame(*frame);
+            }
+            bool finished = job.renderer->traceFrame(*frame);
+            if (job.profile)
+            {
+                if (finished)
+                    job.renderer->profileCounters(*frame);
+                Profiling::profiler.endFrame(!finished);
+            }
+
+            if (finished)
+            {
+                job.renderer->postProcess(*frame);
+                if (job.finished)
+                    job.finished(frameBuffer);
+                if (job.heatmapFinished && job.renderParams.heatmap != RenderParams::NoHeatmap)
+                {
+                    FrameBuffer heatmap(job.size.x, job.size.y);
+                    Renderer::writeHeatmap(*frame, heatmap);
+                    job.heatmapFinished(heatmap);
+                }
+                state = JobState::Finished;
+            }
+        }
+        catch (const std::exception &e)
+        {
+            state = JobState::Failed;
+            error = e.what();
+        }
+
+        std::lock_guard lk(m_mutex);
+        entry.frame = nullptr;
+        entry.state = state;
+        entry.error = error;
+        entry.end = clock::now();
+        release(job);
+    }
+}
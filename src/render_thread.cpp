@@ -8,10 +8,10 @@ namespace rt
     RenderThread::Event::Event(EventType type)
         : type(type) {}
 
-    RenderThread::Event::Event(Scene &scene, FrameBuffer &frameBuffer)
-        : type(EventType::Render), scene(&scene), frameBuffer(&frameBuffer) {}
+    RenderThread::Event::Event(std::shared_ptr<const Scene> scene, FrameBuffer &frameBuffer, uint64_t frame, bool cancelable)
+        : type(EventType::Render), frame(frame), cancelable(cancelable), scene(std::move(scene)), frameBuffer(&frameBuffer) {}
 
-    RenderThread::RenderThread(ThreadPool<Renderer::task_type> *threadPool, Renderer *renderer)
+    RenderThread::RenderThread(WorkStealingPool<Renderer::task_type> *threadPool, Renderer *renderer)
         : m_threadPool(threadPool), m_renderer(renderer),
           renderParams({
               {64, 64},
@@ -31,11 +31,10 @@ namespace rt
         m_eventStream << EventType::Terminate;
     }
 
-    void RenderThread::startRender(Scene &scene, FrameBuffer &frameBuffer)
+    void RenderThread::startRender(Scene &scene, FrameBuffer &frameBuffer, bool cancelable)
     {
-        if (!m_eventStream.isEmpty())
-            return;
-        m_eventStream << Event(scene, frameBuffer);
+        auto snapshot = scene.snapshot();
+        m_eventStream << Event(std::move(snapshot), frameBuffer, ++m_latestFrame, cancelable);
     }
 
     void RenderThread::waitUntilFinished()
@@ -58,41 +57,98 @@ namespace rt
         m_renderer = renderer;
     }
 
-    void RenderThread::run()
+    void RenderThread::frameStarted()
+    {
+        std::lock_guard<std::mutex> lock(m_renderFinished_mutex);
+        m_framesInFlight++;
+        m_isRendering = true;
+        m_renderFinished_cv.notify_all();
+    }
+
+    void RenderThread::frameDone()
+    {
+        std::lock_guard<std::mutex> lock(m_renderFinished_mutex);
+        if (--m_framesInFlight == 0)
+            m_isRendering = false;
+        m_renderFinished_cv.notify_all();
+    }
+
+    std::unique_ptr<Renderer::FrameContext> RenderThread::nextFrame(bool wait)
     {
-        while (true)
+        // Only this thread takes events, so get doesn't block if the stream isn't empty
+        while (!m_terminating && (wait || !m_eventStream.isEmpty()))
         {
             Event event = m_eventStream.get();
             switch (event.type)
             {
             case EventType::Terminate:
-                return;
+                m_terminating = true;
+                break;
             case EventType::Render:
+            {
                 assert(m_renderer != nullptr);
                 assert(event.frameBuffer != nullptr);
 
-                m_renderParams = renderParams;
-
-                m_isRendering = true;
-                m_renderFinished_cv.notify_all();
-
-                std::stringstream      ss;
-                rtstd::formatterstream logger(ss);
-                PixelLogger::logger.setStream(&logger);
+                // Superseded before it started, frames that can't be cancelled are always rendered
+                if (event.cancelable && event.frame != m_latestFrame)
+                    break;
+
+                auto frame = std::make_unique<Renderer::FrameContext>();
+                frame->renderer = m_renderer;
+                frame->threadPool = m_threadPool;
+                frame->scene = event.scene;
+                frame->frameBuffer = event.frameBuffer;
+                frame->renderParams = renderParams;
+                if (event.cancelable)
+                    frame->cancelToken = CancelToken{.latestFrame = &m_latestFrame, .frame = event.frame};
+                frame->frame = event.frame;
+
+                frameStarted();
+                return frame;
+            }
+            }
+        }
+        return nullptr;
+    }
 
-                Profiling::profiler.beginFrame();
+    void RenderThread::run()
+    {
+        // Reused by every frame, only the logged pixel writes to it
+        std::stringstream      ss;
+        rtstd::formatterstream logger(ss);
+
+        FramePipeline pipeline;
+        pipeline.next = [this](bool wait)
+        { return nextFrame(wait); };
+        pipeline.frameBoundary = [this]
+        {
+            if (frameBoundary)
+                frameBoundary();
+        };
+        pipeline.beforeTrace = [&](Renderer::FrameContext &frame)
+        {
+            ss.str("");
+            logger.reset();
+            PixelLogger::logger.setStream(&logger);
 
-                m_renderer->doRender(m_threadPool, event.scene, event.frameBuffer, &m_renderParams);
+            Profiling::profiler.beginFrame();
+        };
+        pipeline.afterTrace = [&](Renderer::FrameContext &frame, bool finished)
+        {
+            if (finished)
+                frame.renderer->profileCounters(frame);
+            Profiling::profiler.endFrame(!finished);
 
-                Profiling::profiler.endFrame();
+            PixelLogger::logger.setStream(nullptr);
+            renderLog.assign(ss.view());
 
-                PixelLogger::logger.setStream(nullptr);
-                renderLog = ss.str();
+            // Cancelled frames are not presented
+            if (!finished)
+                frameDone();
+        };
+        pipeline.present = [this](std::unique_ptr<Renderer::FrameContext> frame)
+        { frameDone(); };
 
-                m_isRendering = false;
-                m_renderFinished_cv.notify_all();
-                break;
-            }
-        }
+        pipeline.run(*m_threadPool);
     }
-}
\ No newline at end of file
+}
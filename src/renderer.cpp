@@ -1,74 +1,375 @@
+#include <frame_arena.h>
 #include <pixel_logger.h>
 #include <profiler.h>
 #include <renderer.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define RT_HAS_RDTSC
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
 namespace rt
 {
     Renderer::Renderer() {}
     Renderer::~Renderer() {}
 
-    void Renderer::render()
+    std::unique_ptr<Renderer> Renderer::createInstance() const { return std::make_unique<Renderer>(); }
+
+    // Tiles taking more than this factor times the average time of the previous frame are split
+    static constexpr double SplitFactor = 4.0;
+
+    // Position of the tile on the Z-order curve
+    static inline uint64_t mortonKey(uint32_t x, uint32_t y)
+    {
+        uint64_t key = 0;
+        for (int bit = 0; bit < 32; bit++)
+            key |= (uint64_t)((x >> bit) & 1) << (2 * bit) | (uint64_t)((y >> bit) & 1) << (2 * bit + 1);
+        return key;
+    }
+
+    // Position of the tile on the Hilbert curve filling a square of side n, n is a power of two
+    static inline uint64_t hilbertKey(uint32_t n, uint32_t x, uint32_t y)
+    {
+        uint64_t key = 0;
+        for (uint32_t s = n / 2; s > 0; s /= 2)
+        {
+            uint32_t rx = (x & s) > 0;
+            uint32_t ry = (y & s) > 0;
+            key += (uint64_t)s * s * ((3 * rx) ^ ry);
+
+            // Rotate the quadrant, so the curve continues where the previous one ended
+            if (ry == 0)
+            {
+                if (rx == 1)
+                {
+                    x = s - 1 - x;
+                    y = s - 1 - y;
+                }
+                std::swap(x, y);
+            }
+        }
+        return key;
+    }
+
+    // Ring around the centre first, then the angle within the ring
+    static inline double spiralKey(const m::u64vec2 &grid, uint32_t x, uint32_t y)
+    {
+        double dx = x + 0.5 - grid.x / 2.0;
+        double dy = y + 0.5 - grid.y / 2.0;
+        double ring = std::floor(std::max(std::abs(dx), std::abs(dy)));
+        return ring + (std::atan2(dy, dx) + m::pi<double>()) / (2 * m::pi<double>() + 1e-6);
+    }
+
+    // Time stamp counter of the cpu, nanoseconds of a steady clock on cpus without one
+    static inline uint64_t readCycleCounter()
+    {
+#ifdef RT_HAS_RDTSC
+        return __rdtsc();
+#else
+        return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+    }
+
+    // False colour of a cost between 0 and 1, from black over blue and red to yellow
+    static inline m::Color<float> heatColor(float t)
     {
-        auto size = frameBuffer->getSize();
+        static const m::Color<float> colors[] = {{0, 0, 0}, {0, 0, 1}, {1, 0, 0}, {1, 1, 0}};
+        constexpr size_t             last = std::size(colors) - 1;
 
-        std::vector<std::future<void>> futures;
-        futures.reserve((size.x / renderParams->tileSize.x + 1) * (size.y / renderParams->tileSize.y + 1));
+        t = std::clamp(t, 0.0f, 1.0f) * last;
+        size_t i = std::min((size_t)t, last - 1);
+        return m::mix(colors[i], colors[i + 1], t - i);
+    }
+
+    void Renderer::planTiles(const m::u64vec2 &size, const m::u64vec2 &grid)
+    {
+        m::u64vec2 tileSize = renderParams->tileSize;
 
-        for (size_t x = 0; x < size.x; x += renderParams->tileSize.x)
+        // Costs of the previous frame only apply, if the tiles are the same
+        bool   hasCosts = m_grid == grid && m_gridCosts.size() == grid.x * grid.y;
+        double averageCost = 0;
+        if (hasCosts)
         {
-            for (size_t y = 0; y < size.y; y += renderParams->tileSize.y)
+            for (double cost : m_gridCosts)
+                averageCost += cost;
+            averageCost /= m_gridCosts.size();
+        }
+
+        uint32_t hilbertSize = 1;
+        while (hilbertSize < std::max(grid.x, grid.y))
+            hilbertSize *= 2;
+
+        m_tiles.clear();
+        m_tileStats.splitCount = 0;
+        for (uint32_t y = 0; y < grid.y; y++)
+            for (uint32_t x = 0; x < grid.x; x++)
             {
-                auto rect = m::Rect(m::u64vec2(x, y), renderParams->tileSize).min(size);
+                uint32_t gridIndex = y * (uint32_t)grid.x + x;
+                double   cost = hasCosts ? m_gridCosts[gridIndex] : 0;
 
-                std::packaged_task<void()> task([rect, this]
-                                                {
-                    Profiling::profiler.profileTask("Render Tile");
-                    renderTile(rect);
-                    Profiling::profiler.profileTask("Get"); });
+                double key;
+                switch (renderParams->tileOrder)
+                {
+                case RenderParams::Morton:
+                    key = (double)mortonKey(x, y);
+                    break;
+                case RenderParams::Hilbert:
+                    key = (double)hilbertKey(hilbertSize, x, y);
+                    break;
+                case RenderParams::Spiral:
+                    key = spiralKey(grid, x, y);
+                    break;
+                case RenderParams::CostDescending:
+                    key = -cost;
+                    break;
+                default:
+                    key = gridIndex;
+                    break;
+                }
 
-                futures.push_back(task.get_future());
-                *threadPool << std::move(task);
+                auto rect = m::Rect(m::u64vec2(x, y) * tileSize, tileSize).min(size);
+
+                if (renderParams->splitExpensiveTiles && hasCosts && cost > SplitFactor * averageCost && rect.size.x > 1 && rect.size.y > 1)
+                {
+                    // The quarters keep the key of the tile, so they are handed out right after each other
+                    m::u64vec2 half = rect.size / m::u64vec2(2);
+                    m::u64vec2 rest = rect.size - half;
+                    m_tiles.push_back({m::Rect(rect.start, half), gridIndex, key});
+                    m_tiles.push_back({m::Rect(rect.start + m::u64vec2(half.x, 0), m::u64vec2(rest.x, half.y)), gridIndex, key});
+                    m_tiles.push_back({m::Rect(rect.start + m::u64vec2(0, half.y), m::u64vec2(half.x, rest.y)), gridIndex, key});
+                    m_tiles.push_back({m::Rect(rect.start + half, rest), gridIndex, key});
+                    m_tileStats.splitCount++;
+                }
+                else
+                    m_tiles.push_back({rect, gridIndex, key});
             }
+
+        if (renderParams->tileOrder != RenderParams::RowMajor)
+            std::stable_sort(m_tiles.begin(), m_tiles.end(), [](const Tile &a, const Tile &b)
+                             { return a.key < b.key; });
+    }
+
+    void Renderer::gatherTileStats(const m::u64vec2 &grid, double frameTime)
+    {
+        m_grid = grid;
+        m_gridCosts.assign(grid.x * grid.y, 0.0);
+
+        double busyTime = 0;
+        for (size_t i = 0; i < m_tiles.size(); i++)
+        {
+            m_gridCosts[m_tiles[i].gridIndex] += m_tileTimes[i];
+            busyTime += m_tileTimes[i];
         }
 
-        Profiling::profiler.profileTask("Waiting for Futures");
+        m_tileStats.tileCount = m_tiles.size();
+        m_tileStats.workerCount = threadPool->getThreadCount() + 1;
+        m_tileStats.frameTime = frameTime;
+        m_tileStats.busyTime = busyTime;
+        m_tileStats.idleTime = std::max(0.0, m_tileStats.workerCount * frameTime - busyTime);
+
+        m_rayStats = frame->rayStats;
+        RayStats::addToTotal(m_rayStats, frameTime);
+    }
+
+    static inline void profileTask(const Renderer::FrameContext &frame, const char *label)
+    {
+        if (frame.profiled)
+            Profiling::profiler.profileTask(label);
+    }
+
+    void Renderer::render()
+    {
+        using clock = std::chrono::steady_clock;
+
+        auto       size = frame->size;
+        m::u64vec2 tileSize = renderParams->tileSize;
+        m::u64vec2 grid = (size + tileSize - m::u64vec2(1)) / tileSize;
+
+        profileTask(*frame, "Plan Tiles");
+        planTiles(size, grid);
+        m_tileTimes.resize(m_tiles.size());
+        m_tileRays.resize(m_tiles.size());
+        frame->tilesDone = 0;
+        frame->tileCount = m_tiles.size();
+        frame->rayStats = RayStats();
 
-        for (auto &&f : futures)
-            f.get();
+        // Tiles are handed out by index, the time between two tiles of a thread is the scheduling overhead
+        auto frameStart = clock::now();
+        threadPool->parallelFor(m_tiles.size(), [&](size_t i)
+                                {
+                                    if (isCancelled())
+                                        return;
+
+                                    auto     start = clock::now();
+                                    RayStats countersAtStart = RayStats::local();
+                                    profileTask(*frame, "Render Tile");
+                                    renderTile(m_tiles[i].rect);
+                                    profileTask(*frame, "Scheduling");
+                                    m_tileTimes[i] = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+                                    {
+                                        RayStats tileStats = RayStats::local() - countersAtStart;
+                                        m_tileRays[i] = tileStats.getRays();
+
+                                        std::lock_guard<std::mutex> lk(frame->rayStatsMutex);
+                                        frame->rayStats += tileStats;
+                                    }
+                                    frame->tilesDone.fetch_add(1, std::memory_order_relaxed); });
+        auto frameEnd = clock::now();
+
+        // The tiles of a cancelled frame would make bad predictions for the next one
+        if (isCancelled())
+            return;
+        gatherTileStats(grid, std::chrono::duration<double, std::milli>(frameEnd - frameStart).count());
+
+        if (renderParams->heatmap == RenderParams::TileTime || renderParams->heatmap == RenderParams::TileRays)
+        {
+            frame->tileCosts.clear();
+            frame->tileCosts.reserve(m_tiles.size());
+            for (size_t i = 0; i < m_tiles.size(); i++)
+                frame->tileCosts.push_back({m_tiles[i].rect, m_tileTimes[i], m_tileRays[i]});
+        }
     }
 
     void Renderer::renderTile(const m::Rect<size_t> &tile)
     {
-        for (size_t y = tile.start.y; y < tile.getEnd().y; y++)
+        uint64_t *pixelCycles = frame->pixelCycles.get();
+        for (size_t y = tile.start.y; y < tile.getEnd().y && !isCancelled(); y++)
             for (size_t x = tile.start.x; x < tile.getEnd().x; x++)
             {
                 if (renderParams->logPixel == m::u64vec2(x, y))
                     PixelLogger::logger.beginLog();
+                uint64_t start = pixelCycles ? readCycleCounter() : 0;
                 renderPixel(m::u64vec2(x, y));
+                if (pixelCycles)
+                    pixelCycles[y * frame->size.x + x] = readCycleCounter() - start;
                 PixelLogger::logger.endLog();
             }
     }
 
     void Renderer::renderPixel(const m::vec2<size_t> &coords) {}
-    void Renderer::beginFrame() {}
-    void Renderer::endFrame() {}
 
-    void Renderer::doRender(ThreadPool<task_type> *threadPool, Scene *scene, FrameBuffer *frameBuffer, RenderParams *renderParams)
+    void Renderer::prepareFrame(FrameContext &frame)
     {
-        this->threadPool = threadPool;
-        this->scene = scene;
-        this->frameBuffer = frameBuffer;
-        this->renderParams = renderParams;
-        Profiling::profiler.profileTask("BeginFrame");
-        beginFrame();
-        Profiling::profiler.profileTask("Render");
+        frame.size = frame.frameBuffer->getSize();
+        frame.radiance = std::make_unique_for_overwrite<m::Color<float>[]>(frame.size.x * frame.size.y);
+        if (frame.renderParams.heatmap == RenderParams::PixelCycles)
+            frame.pixelCycles = std::make_unique<uint64_t[]>(frame.size.x * frame.size.y);
+    }
+
+    bool Renderer::traceFrame(FrameContext &frame)
+    {
+        this->frame = &frame;
+        this->threadPool = frame.threadPool;
+        this->scene = frame.scene.get();
+        this->frameBuffer = frame.frameBuffer;
+        this->renderParams = &frame.renderParams;
+        this->cancelToken = frame.cancelToken;
+        // Scratch memory of the previous frame is released, the arenas are reset on their first use in this one
+        FrameArena::nextFrame();
+        profileTask(frame, "Render");
         render();
-        Profiling::profiler.profileTask("EndFrame");
-        endFrame();
-        Profiling::profiler.endTask();
+        if (frame.profiled)
+            Profiling::profiler.endTask();
         this->renderParams = nullptr;
         this->frameBuffer = nullptr;
         this->scene = nullptr;
         this->threadPool = nullptr;
+        this->frame = nullptr;
+
+        bool cancelled = isCancelled();
+        this->cancelToken = CancelToken();
+        return !cancelled;
+    }
+
+    void Renderer::profileCounters(const FrameContext &frame) const
+    {
+        Profiling::profiler.setCounter("Mrays/s", m_rayStats.getMraysPerSecond(m_tileStats.frameTime));
+        Profiling::profiler.setCounter("Primary rays", (double)m_rayStats[RayStats::PrimaryRays]);
+        Profiling::profiler.setCounter("Reflection rays", (double)m_rayStats[RayStats::ReflectionRays]);
+        Profiling::profiler.setCounter("Shadow rays", (double)m_rayStats[RayStats::ShadowRays]);
+        Profiling::profiler.setCounter("Intersection tests", (double)m_rayStats.getIntersectionTests());
+        Profiling::profiler.setCounter("Voxel steps", (double)m_rayStats[RayStats::VoxelSteps]);
+        Profiling::profiler.setCounter("Texture samples", (double)m_rayStats[RayStats::TextureSamples]);
+    }
+
+    double Renderer::writeHeatmap(const FrameContext &frame, FrameBuffer &frameBuffer)
+    {
+        // The frame buffer may have been resized since the frame was prepared
+        if (frameBuffer.getSize() != frame.size)
+            return 0;
+        frameBuffer.clear();
+
+        // Costs are scaled to the most expensive tile or pixel
+        double maxCost = 0;
+        switch (frame.renderParams.heatmap)
+        {
+        case RenderParams::TileTime:
+        case RenderParams::TileRays:
+        {
+            // Tiles at the border and split tiles are smaller, so their cost is divided by their area
+            auto getCost = [&](const TileCost &tile)
+            {
+                double cost = frame.renderParams.heatmap == RenderParams::TileTime ? tile.time : (double)tile.rays;
+                return cost / (tile.rect.size.x * tile.rect.size.y);
+            };
+
+            for (auto &&tile : frame.tileCosts)
+                maxCost = std::max(maxCost, getCost(tile));
+            for (auto &&tile : frame.tileCosts)
+            {
+                auto color = heatColor(maxCost > 0 ? (float)(getCost(tile) / maxCost) : 0.0f);
+                for (size_t y = tile.rect.start.y; y < tile.rect.getEnd().y; y++)
+                    for (size_t x = tile.rect.start.x; x < tile.rect.getEnd().x; x++)
+                        frameBuffer.at(x, y) = color;
+            }
+            break;
+        }
+        case RenderParams::PixelCycles:
+        {
+            if (!frame.pixelCycles)
+                break;
+
+            size_t pixelCount = frame.size.x * frame.size.y;
+            for (size_t i = 0; i < pixelCount; i++)
+                maxCost = std::max(maxCost, (double)frame.pixelCycles[i]);
+            for (size_t i = 0; i < pixelCount; i++)
+                frameBuffer[i] = heatColor(maxCost > 0 ? (float)(frame.pixelCycles[i] / maxCost) : 0.0f);
+            break;
+        }
+        default:
+            break;
+        }
+        return maxCost;
+    }
+
+    void Renderer::postProcess(FrameContext &frame) {}
+
+    bool Renderer::doRender(WorkStealingPool<task_type> *threadPool, std::shared_ptr<const Scene> scene, FrameBuffer *frameBuffer, RenderParams *renderParams, CancelToken cancelToken)
+    {
+        FrameContext frame{
+            .renderer = this,
+            .threadPool = threadPool,
+            .scene = scene,
+            .frameBuffer = frameBuffer,
+            .renderParams = *renderParams,
+            .cancelToken = cancelToken,
+        };
+
+        Profiling::profiler.profileTask("Prepare Frame");
+        prepareFrame(frame);
+        if (!traceFrame(frame))
+            return false;
+        Profiling::profiler.profileTask("Post Process");
+        postProcess(frame);
+        Profiling::profiler.endTask();
+        return true;
     }
 }
\ No newline at end of file
@@ -27,16 +27,42 @@ namespace rt
                 m_loadingFutures[i].wait();
             m_loadingFutures.erase(m_loadingFutures.begin() + i);
         }
+        // Waits for frames in flight instead of skipping, so everything is published afterwards
+        std::unique_lock publishLock(m_publishMutex);
+        publishDecoded();
     }
 
-    void ResourceContainer::loadTask(ResourceLoader *loader, std::filesystem::path path, const ResourceRef<void> &resource)
+    void ResourceContainer::submitDecoded(const std::shared_ptr<_SharedResourceState> &state)
+    {
+        std::lock_guard lk(m_decodedMutex);
+        state->state = _SharedResourceState::State::Decoded;
+        m_decoded.push_back(state);
+    }
+
+    void ResourceContainer::publish()
+    {
+        // The render thread must not wait for a frame of another thread, decoded resources stay pending until then
+        std::unique_lock publishLock(m_publishMutex, std::try_to_lock);
+        if (publishLock.owns_lock())
+            publishDecoded();
+    }
+
+    void ResourceContainer::publishDecoded()
+    {
+        std::lock_guard lk(m_decodedMutex);
+        for (auto &&state : m_decoded)
+            state->state = _SharedResourceState::State::Loaded;
+        m_decoded.clear();
+    }
+
+    void ResourceContainer::loadTask(ResourceLoader *loader, std::filesystem::path path, ResourceParameters parameters, const ResourceRef<void> &resource)
     {
         try
         {
             if (!std::filesystem::exists(path))
                 throw IOException(IOException::Type::NotFound);
 
-            loader->load(resource, path);
+            loader->load(resource, path, parameters);
         }
         catch (...)
         {
@@ -73,15 +99,21 @@ namespace rt
 
         auto loader = res->second.get();
         auto &path = state.path;
+        auto &parameters = state.parameters;
         ResourceRef<void> resource(state.weak_from_this());
 
-        auto task = std::packaged_task<void()>([loader, path, resource, this]
-                                               { loadTask(loader, path, resource); });
+        auto task = std::packaged_task<void()>([loader, path, parameters, resource, this]
+                                               { loadTask(loader, path, parameters, resource); });
         m_loadingFutures.push_back(task.get_future());
         *m_threadPool << std::move(task);
     }
 
     ResourceRef<void> ResourceContainer::operator+=(const std::filesystem::path &path)
+    {
+        return get(path);
+    }
+
+    ResourceRef<void> ResourceContainer::get(const std::filesystem::path &path, const ResourceParameters &parameters)
     {
         std::optional<std::filesystem::path> _path;
         if (!std::filesystem::exists(path))
@@ -89,7 +121,7 @@ namespace rt
             _path = m_appDir / path;
             if (!std::filesystem::exists(*_path))
             {
-                auto r = m_resources.emplace_back(new _SharedResourceState(*_path, this));
+                auto r = m_resources.emplace_back(new _SharedResourceState(*_path, parameters, this));
                 r->state = _SharedResourceState::State::Failed;
                 r->exception = std::make_exception_ptr(IOException(IOException::NotFound));
                 return std::move(ResourceRef<void>(r));
@@ -97,9 +129,9 @@ namespace rt
         }
 
         for (auto &&resource : m_resources)
-            if (std::filesystem::equivalent(resource->path, _path ? *_path : path))
+            if (std::filesystem::equivalent(resource->path, _path ? *_path : path) && resource->parameters == parameters)
                 return ResourceRef<void>(resource);
 
-        return std::move(ResourceRef<void>(m_resources.emplace_back(new _SharedResourceState(_path ? *_path : path, this))));
+        return std::move(ResourceRef<void>(m_resources.emplace_back(new _SharedResourceState(_path ? *_path : path, parameters, this))));
     }
 } // namespace rt
@@ -1,4 +1,5 @@
 #include <resource_loaders.h>
+#include <thread_pool.h>
 
 #include <fstream>
 #include <stdexcept>
@@ -42,8 +43,24 @@ namespace rt
             return chunk;
         }
 
-        void VoxelGridLoader::load(ResourceRef<void> resource, const std::filesystem::path &path) const
+        static Resources::VoxelGridResource::Acceleration parseAcceleration(const ResourceParameters &parameters)
         {
+            using Acceleration = Resources::VoxelGridResource::Acceleration;
+
+            auto it = parameters.find("acceleration");
+            if (it == parameters.end() || it->second == "brick_map")
+                return Acceleration::BrickMap;
+            if (it->second == "dense")
+                return Acceleration::Dense;
+            if (it->second == "distance_field")
+                return Acceleration::DistanceField;
+            throw std::invalid_argument("Unknown voxel grid acceleration: " + it->second);
+        }
+
+        void VoxelGridLoader::load(ResourceRef<void> resource, const std::filesystem::path &path, const ResourceParameters &parameters) const
+        {
+            auto acceleration = parseAcceleration(parameters);
+
             std::ifstream file(path, std::ios::binary);
             if (!file.is_open())
                 throw IOException(IOException::Type::NotFound);
@@ -85,10 +102,17 @@ namespace rt
             for (size_t i = 0; i < numVoxels; i++)
             {
                 m::u8vec4 voxel = read<m::u8vec4>(file);
-                grid.at(voxel.xyz()).colorIndex = voxel.w;
+                grid.set(voxel.xyz(), {voxel.w});
             }
 
             auto res = std::make_unique<Resources::VoxelGridResource>(std::move(grid));
+            res->acceleration = acceleration;
+
+            if (auto cells = res->grid.getOccupiedBounds())
+            {
+                m::dvec3 fSize(size);
+                res->occupiedBounds = m::AABB<double>(cells->min / fSize - 0.5, cells->max / fSize - 0.5);
+            }
 
             while (file.gcount() >= 4)
             {
@@ -104,10 +128,64 @@ namespace rt
                 }
             }
 
+            if (acceleration == Resources::VoxelGridResource::Acceleration::DistanceField)
+                computeDistanceField(*res);
+
             resource.submit(std::move(res));
         }
 
-        void TextureLoader::load(ResourceRef<void> resource, const std::filesystem::path &path) const
+        // One dimensional Chebyshev distance transform of a row: row[i] = min over j of max(|i - j|, row[j])
+        static void distanceTransform(uint8_t *row, size_t length, size_t stride, std::vector<uint8_t> &buffer)
+        {
+            buffer.resize(length);
+            for (size_t i = 0; i < length; i++)
+                buffer[i] = row[i * stride];
+
+            for (size_t i = 0; i < length; i++)
+            {
+                uint8_t best = buffer[i];
+                // max(d, x) >= d, so nothing closer can be found once d reaches the best distance
+                for (size_t d = 1; d < best; d++)
+                {
+                    if (i >= d)
+                        best = std::min(best, std::max((uint8_t)d, buffer[i - d]));
+                    if (i + d < length)
+                        best = std::min(best, std::max((uint8_t)d, buffer[i + d]));
+                }
+                row[i * stride] = best;
+            }
+        }
+
+        void VoxelGridLoader::computeDistanceField(Resources::VoxelGridResource &resource) const
+        {
+            auto  size = resource.grid.getSize();
+            auto &field = resource.distanceField;
+
+            field.resize(resource.grid.length());
+
+            m_threadPool->parallelFor(size.z, [&](size_t z)
+                                      {
+                                          for (size_t y = 0; y < size.y; y++)
+                                              for (size_t x = 0; x < size.x; x++)
+                                                  field[x + y * size.x + z * size.x * size.y] = resource.grid.at(x, y, z).colorIndex ? 0 : Resources::VoxelGridResource::MaxDistance; });
+
+            // The Chebyshev distance is separable, it is computed with one pass along every axis
+            const m::u64vec3 strides(1, size.x, size.x * size.y);
+            for (int axis = 0; axis < 3; axis++)
+            {
+                int    a1 = (axis + 1) % 3;
+                int    a2 = (axis + 2) % 3;
+                size_t rowCount = size[a1] * size[a2];
+
+                m_threadPool->parallelFor(rowCount, [&](size_t row)
+                                          {
+                                              thread_local std::vector<uint8_t> buffer;
+                                              size_t start = (row % size[a1]) * strides[a1] + (row / size[a1]) * strides[a2];
+                                              distanceTransform(field.data() + start, size[axis], strides[axis], buffer); });
+            }
+        }
+
+        void TextureLoader::load(ResourceRef<void> resource, const std::filesystem::path &path, const ResourceParameters &parameters) const
         {
             auto pathStr = std::move(path.string());
 
@@ -1,51 +1,157 @@
+#include <cpu_dispatch.h>
 #include <pixel_logger.h>
 #include <rt_renderer.h>
 
 namespace rt
 {
-    void RTRenderer::beginFrame()
+    template <typename T>
+    std::unique_ptr<Renderer> BasicRTRenderer<T>::createInstance() const
     {
-        scene->cacheFrameData(frameBuffer->getSize());
+        return std::make_unique<BasicRTRenderer<T>>();
     }
 
-    void RTRenderer::renderPixel(const m::vec2<size_t> &pixelCoords)
+    template <typename T>
+    void BasicRTRenderer<T>::prepareFrame(FrameContext &frame)
     {
-        auto screenSize = frameBuffer->getSize();
-        auto coords = static_cast<m::dvec2>(pixelCoords) / static_cast<m::dvec2>(screenSize) * 2.0 - m::dvec2(1);
+        RTRenderer::prepareFrame(frame);
+        frame.scene->cacheFrameData(frame.size);
+        frame.scene->buildAccelerationStructure<T>(frame.slot);
+        // The camera may be cached again for the next frame, while this one is traced
+        frame.inverseCamera = frame.scene->camera.cached.inverseMatrix;
+    }
+
+    template <typename T>
+    void BasicRTRenderer<T>::renderPixel(const m::vec2<size_t> &pixelCoords)
+    {
+        auto screenSize = frame->size;
+        auto coords = static_cast<m::vec2<T>>(pixelCoords) / static_cast<m::vec2<T>>(screenSize) * T(2) - m::vec2<T>(1);
 
-        auto invCam = scene->camera.cached.inverseMatrix;
+        m::mat4<T> invCam(frame->inverseCamera);
 
         // Ray is in camera space
-        m::ray<double> ray(m::dvec3(coords, -1), m::dvec3(0, 0, 1));
+        m::ray<T> ray(m::vec3<T>(coords, -1), m::vec3<T>(0, 0, 1));
 
         PIXEL_LOGGER_LOG(ray, "\n");
 
         // Ray is in world space now
         ray = ray.transformPerspective(invCam);
 
-        auto color = castPropagationRay(ray, renderParams->recursionDepth);
+        RayStats::count(RayStats::PrimaryRays);
+        RayStats::countDepth(0);
+        auto color = trace(ray, renderParams->recursionDepth);
+
+        frame->at(pixelCoords) = color;
+    }
+
+    template <typename T>
+    void BasicRTRenderer<T>::renderTile(const m::Rect<size_t> &tile)
+    {
+        size_t packetSize = std::min(renderParams->packetSize, MaxPacketSize);
 
-        // Tone mapping
-        switch (renderParams->toneMappingAlgorithm)
+        // The pixel logger follows single rays, so the tile of the logged pixel is rendered without packets,
+        // just like all tiles, whose pixels are measured one by one
+        if (packetSize <= 1 || (renderParams->logPixel && tile.contains(*renderParams->logPixel)) || frame->pixelCycles)
+        {
+            Renderer::renderTile(tile);
+            return;
+        }
+
+        // The pixels of a packet form a block, that is as square as possible: 4 -> 2x2, 8 -> 4x2, 16 -> 4x4
+        m::u64vec2 blockSize(1);
+        while (blockSize.x * blockSize.y < packetSize)
+            (blockSize.x <= blockSize.y ? blockSize.x : blockSize.y) *= 2;
+
+        auto       screenSize = static_cast<m::vec2<T>>(frame->size);
+        m::mat4<T> invCam(frame->inverseCamera);
+
+        alignas(64) T coordsX[MaxPacketSize];
+        alignas(64) T coordsY[MaxPacketSize];
+        m::u64vec2    pixels[MaxPacketSize];
+
+        BasicRayPacket<T> packet;
+        for (size_t blockY = tile.start.y; blockY < tile.getEnd().y && !isCancelled(); blockY += blockSize.y)
+            for (size_t blockX = tile.start.x; blockX < tile.getEnd().x; blockX += blockSize.x)
+            {
+                // Blocks at the border of the tile only have some of their lanes active
+                size_t size = 0;
+                for (size_t y = blockY; y < std::min(blockY + blockSize.y, tile.getEnd().y); y++)
+                    for (size_t x = blockX; x < std::min(blockX + blockSize.x, tile.getEnd().x); x++)
+                    {
+                        pixels[size] = m::u64vec2(x, y);
+                        coordsX[size] = T(x) / screenSize.x * T(2) - T(1);
+                        coordsY[size] = T(y) / screenSize.y * T(2) - T(1);
+                        size++;
+                    }
+
+                packet.generateCameraRays(coordsX, coordsY, size, invCam);
+                RayStats::count(RayStats::PrimaryRays, size);
+                RayStats::local().depths[0] += size;
+
+                BasicPacketHits<T> hits;
+                scene->castPacket(packet, hits, frame->slot);
+
+                // Shading and all secondary rays are traced one by one
+                for (size_t i = 0; i < size; i++)
+                {
+                    frame->at(pixels[i]) = shade(m::ray<double>(packet[i]), scene->resolvePacketHit(packet, hits, i, frame->slot), renderParams->recursionDepth);
+                }
+            }
+    }
+
+    static inline m::Color<float> toneMapKernelBody(m::Color<float> color, const RenderParams &params)
+    {
+        switch (params.toneMappingAlgorithm)
         {
         case RenderParams::Reinhard:
             color = color / (color + m::Color<float>(1));
             break;
         case RenderParams::Exposure:
-            color = m::fvec3(1.0f) - m::exp(-color * renderParams->exposure);
+            color = m::fvec3(1.0f) - m::exp(-color * params.exposure);
             break;
         }
         // gamma correction
-        color = m::pow(color * renderParams->scale, m::fvec3(1.0f / renderParams->gamma));
+        return m::pow(color * params.scale, m::fvec3(1.0f / params.gamma));
+    }
+
+    RT_KERNEL(m::Color<float>, toneMapKernel, (m::Color<float> color, const RenderParams &params), (color, params))
+
+    template <typename T>
+    void BasicRTRenderer<T>::postProcess(FrameContext &frame)
+    {
+        // The frame buffer may have been resized since the frame was prepared
+        if (frame.frameBuffer->getSize() != frame.size)
+            return;
+
+        if (frame.renderParams.heatmap != RenderParams::NoHeatmap && frame.renderParams.showHeatmap)
+        {
+            writeHeatmap(frame, *frame.frameBuffer);
+            return;
+        }
 
-        frameBuffer->at(pixelCoords) = color;
+        frame.threadPool->parallelFor(frame.size.y, [&](size_t y)
+                                      {
+                                          for (size_t x = 0; x < frame.size.x; x++)
+                                              frame.frameBuffer->at(x, y) = toneMapKernel(frame.at(m::u64vec2(x, y)), frame.renderParams); });
     }
 
-    m::Color<float> RTRenderer::castPropagationRay(const m::ray<double> &ray, int recursion) const
+    template <typename T>
+    m::Color<float> BasicRTRenderer<T>::castPropagationRay(const m::ray<double> &ray, int recursion) const
+    {
+        RayStats::count(RayStats::ReflectionRays);
+        RayStats::countDepth(std::max<int64_t>((int64_t)renderParams->recursionDepth - recursion, 0));
+        return trace(m::ray<T>(ray), recursion);
+    }
+
+    template <typename T>
+    m::Color<float> BasicRTRenderer<T>::trace(const m::ray<T> &ray, int recursion) const
     {
         PIXEL_LOGGER_LOG("Cast Propagation Ray { ");
-        auto maybeIntersection = scene->castRay(ray);
+        return shade(m::ray<double>(ray), scene->castRay(ray, std::nullopt, frame->slot), recursion);
+    }
 
+    template <typename T>
+    m::Color<float> BasicRTRenderer<T>::shade(const m::ray<double> &ray, const std::optional<Intersection> &maybeIntersection, int recursion) const
+    {
         if (!maybeIntersection)
         {
             PIXEL_LOGGER_LOG("No Intersection! }\n");
@@ -71,20 +177,24 @@ namespace rt
         return result;
     }
 
-    std::optional<m::Color<float>> RTRenderer::castLightRay(const m::dvec3 position, const SceneLight &light) const
+    template <typename T>
+    std::optional<m::Color<float>> BasicRTRenderer<T>::castLightRay(const m::dvec3 position, const SceneLight &light) const
     {
         auto dir = light.getLightDirection(position);
         if (!dir)
             return std::nullopt;
 
-        m::ray<double> ray(position,
-                           dir.value());
+        m::ray<T> ray(m::vec3<T>(position),
+                      m::vec3<T>(dir.value()));
 
-        auto maybeIntersection = scene->castRay(ray, light.getMaxDistance());
+        RayStats::count(RayStats::ShadowRays);
 
-        if (maybeIntersection)
+        if (scene->occluded(ray, light.getMaxDistance(), frame->slot))
             return std::nullopt;
 
         return light.getColor(position);
     }
+
+    template class BasicRTRenderer<float>;
+    template class BasicRTRenderer<double>;
 }
\ No newline at end of file
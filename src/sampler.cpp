@@ -1,4 +1,6 @@
+#include <cpu_dispatch.h>
 #include <map>
+#include <ray_stats.h>
 #include <rt_imgui.h>
 #include <scene/sampler.h>
 #include <typeinfo>
@@ -11,6 +13,7 @@ namespace rt
     {
         if (!this)
             return invalidColor;
+        RayStats::count(RayStats::TextureSamples);
         switch (info.type)
         {
         case SampleInfoType::UV:
@@ -59,6 +62,23 @@ namespace rt
         return texture->pixelAt(texCoords);
     }
 
+    namespace Samplers
+    {
+        m::Color<float> bilinearFilterBody(const TextureSampler &sampler, m::fvec2 texPos, const m::uvec2 &size)
+        {
+            m::ivec2 t1 = m::floor(texPos);
+            m::ivec2 t2 = m::ceil(texPos);
+            m::ivec2 t3(t1.x, t2.y);
+            m::ivec2 t4(t2.x, t1.y);
+
+            auto c1 = m::mix(sampler.samplePoint(t1, size), sampler.samplePoint(t3, size), m::fract(texPos.y));
+            auto c2 = m::mix(sampler.samplePoint(t4, size), sampler.samplePoint(t2, size), m::fract(texPos.y));
+            return m::mix(c1, c2, m::fract(texPos.x));
+        }
+
+        RT_KERNEL(m::Color<float>, bilinearFilter, (const TextureSampler &sampler, m::fvec2 texPos, const m::uvec2 &size), (sampler, texPos, size))
+    }
+
     m::Color<float> Samplers::TextureSampler::sampleUV(const m::fvec2 &uv) const
     {
         if (!texture)
@@ -74,17 +94,7 @@ namespace rt
         }
 
         case FilterMethod::Linear:
-        {
-            auto     texPos = uv * (m::fvec2)(size - m::uvec2(1));
-            m::ivec2 t1 = m::floor(texPos);
-            m::ivec2 t2 = m::ceil(texPos);
-            m::ivec2 t3(t1.x, t2.y);
-            m::ivec2 t4(t2.x, t1.y);
-
-            auto c1 = m::mix(samplePoint(t1, size), samplePoint(t3, size), m::fract(texPos.y));
-            auto c2 = m::mix(samplePoint(t4, size), samplePoint(t2, size), m::fract(texPos.y));
-            return m::mix(c1, c2, m::fract(texPos.x));
-        }
+            return bilinearFilter(*this, uv * (m::fvec2)(size - m::uvec2(1)), size);
         default:
             return invalidColor;
         }
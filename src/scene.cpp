@@ -8,10 +8,10 @@
 namespace rt
 {
 
-    Scene::Scene(std::vector<std::unique_ptr<SceneShape>> &objects, const Camera &camera)
+    Scene::Scene(shape_collection_type &objects, const Camera &camera)
         : objects(std::move(objects)), camera(camera) {}
 
-    Scene::Scene(std::vector<std::unique_ptr<SceneShape>> &&objects, const Camera &camera)
+    Scene::Scene(shape_collection_type &&objects, const Camera &camera)
         : objects(std::move(objects)), camera(camera) {}
 
     Scene::Scene(const Camera &camera)
@@ -19,9 +19,81 @@ namespace rt
 
     Scene::~Scene() {}
 
+    // Copies objects for a snapshot, the copy of the previous snapshot is reused if its source didn't change
+    class SnapshotCopier
+    {
+        const std::vector<Scene::SnapshotCopy> &m_previous;
+        std::vector<Scene::SnapshotCopy>       &m_copies;
+
+    public:
+        SnapshotCopier(const std::vector<Scene::SnapshotCopy> &previous, std::vector<Scene::SnapshotCopy> &copies)
+            : m_previous(previous), m_copies(copies) {}
+
+        template <typename T>
+        std::shared_ptr<T> copy(const std::shared_ptr<T> &object)
+        {
+            size_t              i = m_copies.size();
+            Scene::SnapshotCopy copy{object.get(), object->getRevision(), nullptr};
+            if (i < m_previous.size() && m_previous[i].source == copy.source && m_previous[i].revision == copy.revision)
+                copy.copy = m_previous[i].copy;
+            else
+                copy.copy = std::shared_ptr<T>(object->clone());
+            m_copies.push_back(copy);
+            return std::static_pointer_cast<T>(copy.copy);
+        }
+    };
+
+    static void copyObjects(const Scene &scene, Scene &snapshot, SnapshotCopier &copier)
+    {
+        snapshot.objects.reserve(scene.objects.size());
+        for (auto &&object : scene.objects)
+            snapshot.objects.push_back(copier.copy(object));
+        snapshot.lights.reserve(scene.lights.size());
+        for (auto &&light : scene.lights)
+            snapshot.lights.push_back(copier.copy(light));
+        for (auto &&[index, material] : scene.materials)
+            snapshot.materials.emplace(index, copier.copy(material));
+    }
+
+    std::shared_ptr<const Scene> Scene::snapshot()
+    {
+        auto snapshot = std::make_shared<Scene>(camera);
+        snapshot->m_compiled = m_compiled;
+        snapshot->m_structureRevision = m_structureRevision;
+        snapshot->environmentTexture = environmentTexture;
+
+        // Copies are matched by position, that only holds while no shapes were added or removed
+        std::vector<SnapshotCopy> previous;
+        if (m_snapshotStructureRevision == m_structureRevision)
+            previous = std::move(m_snapshotCopies);
+        m_snapshotCopies.clear();
+        m_snapshotStructureRevision = m_structureRevision;
+
+        SnapshotCopier copier(previous, m_snapshotCopies);
+        copyObjects(*this, *snapshot, copier);
+
+        return snapshot;
+    }
+
+    std::shared_ptr<const Scene> Scene::detachedSnapshot() const
+    {
+        // The new scene starts with compiled scenes of its own
+        auto snapshot = std::make_shared<Scene>(camera);
+        snapshot->m_structureRevision = m_structureRevision;
+        snapshot->environmentTexture = environmentTexture;
+
+        std::vector<SnapshotCopy> previous;
+        std::vector<SnapshotCopy> copies;
+        SnapshotCopier            copier(previous, copies);
+        copyObjects(*this, *snapshot, copier);
+
+        return snapshot;
+    }
+
     void Scene::addShape(SceneShape *shape)
     {
         objects.emplace_back(shape);
+        markStructureChanged();
     }
 
     void Scene::addLight(SceneLight *light)
@@ -46,46 +118,66 @@ namespace rt
     void Scene::cacheFrameData(const m::u64vec2 &screenSize) const
     {
         for (auto &&object : objects)
-            object->transform.cacheMatrix();
+            object->transform.updateCache();
         camera.cacheMatrix(screenSize.x / (double)screenSize.y);
     }
 
-    // Ray is in world space
-    std::optional<Intersection> Scene::castRay(const m::ray<double> &ray, std::optional<double> maxLength2) const
+    template <typename T>
+    void Scene::buildAccelerationStructure(size_t slot) const
     {
-        Intersection nearestInter;
-        double       nearestDist2 = std::numeric_limits<double>::max();
-
-        for (auto &&i : objects)
-        {
-            auto &mats = i->transform.cached;
+        auto &compiled = std::get<std::array<BasicCompiledScene<T>, FrameSlots>>(*m_compiled)[slot];
+        if (compiled.getStructureRevision() != m_structureRevision || !compiled.refit(objects))
+            compiled.build(objects, m_structureRevision);
+    }
 
-            // Ray is in local object space now
-            m::ray localRay = mats.inverseMatrix * ray;
+    // The ray parameter of a point is its distance divided by the length of the direction.
+    // It is the same in world and local object space, so hits of different shapes can be compared directly.
+    template <typename T>
+    static inline T toRayParameter(const m::ray<T> &ray, std::optional<double> maxLength2)
+    {
+        if (!maxLength2)
+            return std::numeric_limits<T>::infinity();
+        return T(std::sqrt(*maxLength2 / m::length2(m::dvec3(ray.direction))));
+    }
 
-            auto maybeIntersection = i->intersect(localRay);
+    // Ray is in world space
+    template <typename T>
+    std::optional<Intersection> Scene::castRay(const m::ray<T> &ray, std::optional<double> maxLength2, size_t slot) const
+    {
+        return getCompiled<T>(slot).castRay(ray, toRayParameter(ray, maxLength2));
+    }
 
-            if (!maybeIntersection)
-                continue;
+    // Ray is in world space
+    template <typename T>
+    bool Scene::occluded(const m::ray<T> &ray, std::optional<double> maxLength2, size_t slot) const
+    {
+        return getCompiled<T>(slot).occluded(ray, toRayParameter(ray, maxLength2));
+    }
 
-            auto &intersection = maybeIntersection.value();
+    // Packet is in world space
+    template <typename T>
+    void Scene::castPacket(const BasicRayPacket<T> &packet, BasicPacketHits<T> &hits, size_t slot) const
+    {
+        getCompiled<T>(slot).castPacket(packet, hits);
+    }
 
-            // Transform intersection details back to world space
-            intersection.position = mats.matrix * m::dvec4(intersection.position, 1.0);
-            intersection.normal = mats.inverseTransposeMatrix * m::dvec4(intersection.normal, 0.0);
+    template <typename T>
+    std::optional<Intersection> Scene::resolvePacketHit(const BasicRayPacket<T> &packet, const BasicPacketHits<T> &hits, size_t i, size_t slot) const
+    {
+        return getCompiled<T>(slot).resolvePacketHit(packet, hits, i);
+    }
 
-            double dist2 = m::distance2(ray.origin, intersection.position);
-            if (dist2 < nearestDist2 && (!maxLength2 || dist2 < *maxLength2))
-            {
-                nearestDist2 = dist2;
-                nearestInter = intersection;
-            }
-        }
+    template void                        Scene::buildAccelerationStructure<float>(size_t slot) const;
+    template std::optional<Intersection> Scene::castRay(const m::ray<float> &ray, std::optional<double> maxLength2, size_t slot) const;
+    template bool                        Scene::occluded(const m::ray<float> &ray, std::optional<double> maxLength2, size_t slot) const;
+    template void                        Scene::castPacket(const BasicRayPacket<float> &packet, BasicPacketHits<float> &hits, size_t slot) const;
+    template std::optional<Intersection> Scene::resolvePacketHit(const BasicRayPacket<float> &packet, const BasicPacketHits<float> &hits, size_t i, size_t slot) const;
 
-        if (nearestDist2 != std::numeric_limits<double>::max())
-            return nearestInter;
-        return std::nullopt;
-    }
+    template void                        Scene::buildAccelerationStructure<double>(size_t slot) const;
+    template std::optional<Intersection> Scene::castRay(const m::ray<double> &ray, std::optional<double> maxLength2, size_t slot) const;
+    template bool                        Scene::occluded(const m::ray<double> &ray, std::optional<double> maxLength2, size_t slot) const;
+    template void                        Scene::castPacket(const BasicRayPacket<double> &packet, BasicPacketHits<double> &hits, size_t slot) const;
+    template std::optional<Intersection> Scene::resolvePacketHit(const BasicRayPacket<double> &packet, const BasicPacketHits<double> &hits, size_t i, size_t slot) const;
 
     template <typename _It>
     bool TreeList(const _It &begin, const _It &end)
@@ -96,7 +188,11 @@ namespace rt
             ImGui::PushID((void *)it.operator->());
             if (ImGui::TreeNode((*it)->name.c_str()))
             {
-                changed |= (*it)->onInspectorGUI();
+                if ((*it)->onInspectorGUI())
+                {
+                    (*it)->markChanged();
+                    changed = true;
+                }
                 ImGui::TreePop();
             }
             ImGui::PopID();
@@ -119,7 +215,11 @@ namespace rt
                 ImGui::PushID((int)k);
                 if (ImGui::TreeNode(m->name.c_str()))
                 {
-                    changed |= m->onInspectorGUI();
+                    if (m->onInspectorGUI())
+                    {
+                        m->markChanged();
+                        changed = true;
+                    }
                     ImGui::TreePop();
                 }
                 ImGui::PopID();
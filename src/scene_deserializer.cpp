@@ -54,8 +54,24 @@ namespace rt
             for (const auto &resource : node)
             {
                 auto name = resource.first.as<std::string>();
-                auto path = resource.second.as<std::string>();
-                resources.emplace(name, *m_resources += path);
+                if (resource.second.IsScalar())
+                {
+                    resources.emplace(name, *m_resources += resource.second.as<std::string>());
+                    continue;
+                }
+
+                // Resource with loader parameters, e.g. { path: castle.vox, acceleration: distance_field }
+                assertNode(resource.second.IsMap(), "Resource must be a path or a map");
+                assertNode(resource.second["path"], "Resource map must contain a path");
+
+                ResourceParameters parameters;
+                for (const auto &parameter : resource.second)
+                {
+                    auto key = parameter.first.as<std::string>();
+                    if (key != "path")
+                        parameters.emplace(key, parameter.second.as<std::string>());
+                }
+                resources.emplace(name, m_resources->get(resource.second["path"].as<std::string>(), parameters));
             }
         }
         return resources;
@@ -99,6 +115,7 @@ namespace rt
 
         deserialize(scene.materials, _getAlias(node, "materials", "material", "mat", "mats", "m"));
         deserialize(scene.objects, _getAlias(node, "shapes", "shape", "objects", "object", "objs", "obj", "s"));
+        scene.markStructureChanged();
         deserialize(scene.lights, _getAlias(node, "lights", "light", "l"));
         deserialize(scene.camera, _getAlias(node, "camera", "cam", "c"));
         deserialize(scene.environmentTexture, _getAlias(node, "environment_tex", "environment", "env_tex", "env", "e"));
@@ -514,6 +531,7 @@ namespace rt
             deserialize(transform.position, node["position"]);
             deserialize(transform.rotation, node["rotation"]);
             deserialize(transform.scale, node["scale"]);
+            transform.markChanged();
         }
         return transform;
     }
@@ -52,7 +52,18 @@ namespace rt
         emitter << YAML::BeginMap;
         for (auto &&[resource, id] : _data->resourceMap)
         {
-            emitter << YAML::Key << id << YAML::Value << resource.getPath().string();
+            emitter << YAML::Key << id << YAML::Value;
+            if (resource.getParameters().empty())
+            {
+                emitter << resource.getPath().string();
+                continue;
+            }
+
+            emitter << YAML::BeginMap
+                    << YAML::Key << "path" << YAML::Value << resource.getPath().string();
+            for (auto &&[key, value] : resource.getParameters())
+                emitter << YAML::Key << key << YAML::Value << value;
+            emitter << YAML::EndMap;
         }
         emitter << YAML::EndMap;
         _data = nullptr;
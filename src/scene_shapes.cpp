@@ -1,8 +1,10 @@
 #include <scene/scene_shapes.h>
 
+#include <cpu_dispatch.h>
 #include <stream_formatter.h>
 
 #include <pixel_logger.h>
+#include <ray_stats.h>
 #include <rt_imgui.h>
 
 namespace rt
@@ -10,9 +12,28 @@ namespace rt
     SceneShape::SceneShape(const std::string_view &name, const Transform &transform, size_t materialIndex)
         : transform(transform), materialIndex(materialIndex), SceneObject(name) {}
 
+    bool SceneShape::occludes(const m::ray<double> &ray, double tMax) const
+    {
+        auto intersection = intersect(ray);
+        return intersection && intersection->t < tMax;
+    }
+
+    std::optional<m::AABB<double>> SceneShape::getLocalBounds() const { return std::nullopt; }
+
+    std::optional<m::AABB<double>> SceneShape::getBounds() const
+    {
+        auto bounds = getLocalBounds();
+        if (!bounds)
+            return std::nullopt;
+        return bounds->transform(transform.cached.matrix);
+    }
+
     bool SceneShape::onInspectorGUI()
     {
-        return rtImGui::Drag("Transform", transform, 0.01f);
+        if (!rtImGui::Drag("Transform", transform, 0.01f))
+            return false;
+        transform.markChanged();
+        return true;
     }
 
     namespace Shapes
@@ -24,7 +45,7 @@ namespace rt
         Sphere::Sphere(double radius, const Transform &transform, size_t materialIndex)
             : radius(radius), SceneShape("Sphere", transform, materialIndex) {}
 
-        std::optional<Intersection> Sphere::intersect(const m::ray<double> &ray) const
+        static inline std::optional<double> sphereDistance(const m::ray<double> &ray, double radius)
         {
             const m::dvec3 &o = ray.origin;
             const m::dvec3 &d = ray.direction;
@@ -41,9 +62,18 @@ namespace rt
             double t = (-b - std::sqrt(result)) / (2 * a);
             if (t < 0.01)
                 return std::nullopt;
+            return t;
+        }
+
+        std::optional<Intersection> Sphere::intersect(const m::ray<double> &ray) const
+        {
+            auto t = sphereDistance(ray, radius);
+            if (!t)
+                return std::nullopt;
 
             Intersection i;
-            i.position = ray(t);
+            i.t = *t;
+            i.position = ray(*t);
             i.normal = i.position;
             i.object = (SceneShape *)this;
             i.sampleInfo = {
@@ -53,9 +83,27 @@ namespace rt
             return i;
         }
 
+        bool Sphere::occludes(const m::ray<double> &ray, double tMax) const
+        {
+            auto t = sphereDistance(ray, radius);
+            return t && *t < tMax;
+        }
+
+        std::optional<m::AABB<double>> Sphere::getLocalBounds() const
+        {
+            double r = m::abs(radius);
+            return m::AABB<double>(m::dvec3(-r), m::dvec3(r));
+        }
+
         bool Sphere::onInspectorGUI()
         {
-            return SceneShape::onInspectorGUI() | rtImGui::Drag("Radius", radius, 0.01f);
+            bool changed = SceneShape::onInspectorGUI();
+            if (rtImGui::Drag("Radius", radius, 0.01f))
+            {
+                markChanged();
+                changed = true;
+            }
+            return changed;
         }
 
         std::ostream &Sphere::toString(std::ostream &stream) const
@@ -77,6 +125,7 @@ namespace rt
             if (t < 0.01)
                 return std::nullopt;
             Intersection i;
+            i.t = t;
             i.position = ray(t);
             i.normal = m::dvec3(0, 1, 0);
             i.object = (SceneShape *)this;
@@ -87,6 +136,12 @@ namespace rt
             return i;
         }
 
+        bool Plane::occludes(const m::ray<double> &ray, double tMax) const
+        {
+            double t = -ray.origin.y / ray.direction.y;
+            return t >= 0.01 && t < tMax;
+        }
+
         std::ostream &Plane::toString(std::ostream &stream) const
         {
             return stream << "Plane { name: \"" << name << "\", transform: " << transform << " }";
@@ -114,6 +169,7 @@ namespace rt
 
             if (p[D1] <= 0.5 && p[D1] >= -0.5 && p[D2] <= 0.5 && p[D2] >= -0.5)
             {
+                intersection->t = t;
                 intersection->position = p;
                 intersection->normal[D] = s;
                 intersection->sampleInfo.type = SampleInfoType::UV;
@@ -138,6 +194,22 @@ namespace rt
             return std::nullopt;
         }
 
+        // Slab test against the unit cube, returns the distance to the face the ray enters through
+        inline std::optional<double> cubeDistance(const m::ray<double> &ray)
+        {
+            m::dvec3 t0 = (m::dvec3(-0.5) - ray.origin) / ray.direction;
+            m::dvec3 t1 = (m::dvec3(0.5) - ray.origin) / ray.direction;
+            m::dvec3 tNear = glm::min(t0, t1);
+            m::dvec3 tFar = glm::max(t0, t1);
+
+            double tEnter = std::max({tNear.x, tNear.y, tNear.z});
+            double tExit = std::min({tFar.x, tFar.y, tFar.z});
+
+            if (tEnter > tExit || tEnter <= 0.01)
+                return std::nullopt;
+            return tEnter;
+        }
+
         std::optional<Intersection> Cube::intersect(const m::ray<double> &ray) const
         {
             auto intersection = cubeIntersection(ray);
@@ -146,6 +218,17 @@ namespace rt
             return intersection;
         }
 
+        bool Cube::occludes(const m::ray<double> &ray, double tMax) const
+        {
+            auto t = cubeDistance(ray);
+            return t && *t < tMax;
+        }
+
+        std::optional<m::AABB<double>> Cube::getLocalBounds() const
+        {
+            return m::AABB<double>(m::dvec3(-0.5), m::dvec3(0.5));
+        }
+
         std::ostream &Cube::toString(std::ostream &stream) const
         {
             return stream << "Cube { name: \"" << name << "\", transform: " << transform << " }";
@@ -156,124 +239,201 @@ namespace rt
         VoxelShape::VoxelShape(ResourceRef<Resources::VoxelGridResource> grid, const Transform &transform, size_t materialIndex)
             : grid(grid), SceneShape("Voxel Grid", transform, materialIndex) {}
 
-        template <size_t D>
-        inline m::dvec3 calcU(const m::ray<double> &ray)
+        struct VoxelHit
         {
-            if (ray.direction[D] == 0)
-                return {INFINITY, INFINITY, INFINITY};
-            double h = (ray.direction[D] > 0) ? m::ceil(ray.origin[D] - 0.0001) : m::floor(ray.origin[D] + 0.0001);
-            return ray.direction * ((h - ray.origin[D]) / ray.direction[D]);
-        }
-
-        std::optional<Intersection> VoxelShape::intersect(const m::ray<double> &ray_) const
+            double        t;
+            m::dvec3      normal;
+            unsigned char colorIndex;
+        };
+
+        // Steps through the grid cell by cell, until a filled voxel is hit.
+        // Depending on the acceleration of the resource, empty bricks or the empty cells around a cell are skipped in one step.
+        // Ray is in local object space, the grid is mapped onto the unit cube.
+        static inline std::optional<VoxelHit> castVoxelRayBody(const Resources::VoxelGridResource &resource, const m::ray<double> &localRay, double tMax, size_t &steps)
         {
-            if (!grid)
+            using Acceleration = Resources::VoxelGridResource::Acceleration;
+
+            const VoxelGrid &grid = resource.grid;
+
+            auto size = grid.getSize();
+            auto fSize = (m::dvec3)size;
+
+            // Ray in grid space, every cell has a size of 1. The ray parameter stays the same.
+            m::ray<double> ray((localRay.origin + 0.5) * fSize, localRay.direction * fSize);
+
+            m::dvec3 invDirection = 1.0 / ray.direction;
+
+            m::dvec3 t0 = -ray.origin * invDirection;
+            m::dvec3 t1 = (fSize - ray.origin) * invDirection;
+            m::dvec3 tNear = glm::min(t0, t1);
+            m::dvec3 tFar = glm::max(t0, t1);
+
+            double tEnter = std::max({tNear.x, tNear.y, tNear.z});
+            double tExit = std::min({tFar.x, tFar.y, tFar.z, tMax});
+
+            if (tEnter > tExit || tExit < 0)
                 return std::nullopt;
-            VoxelGrid &grid = this->grid->grid;
 
-            auto           size = (m::dvec3)grid.getSize();
-            m::ray<double> ray;
+            // When the ray starts inside the grid, it starts on the surface of a voxel (reflection and shadow rays),
+            // so the first cell is not tested to avoid hitting that voxel again
+            bool     startsInside = tEnter <= 0;
+            double   t = startsInside ? 0 : tEnter;
+            int      axis = tNear.x > tNear.y ? (tNear.x > tNear.z ? 0 : 2) : (tNear.y > tNear.z ? 1 : 2);
+            m::dvec3 entry = ray(t);
+
+            m::i64vec3 cell = m::clamp(m::i64vec3(m::floor(entry)), m::i64vec3(0), m::i64vec3(size) - m::i64vec3(1));
+            m::i64vec3 step(ray.direction.x < 0 ? -1 : 1, ray.direction.y < 0 ? -1 : 1, ray.direction.z < 0 ? -1 : 1);
 
-            auto maybeIntersection = cubeIntersection(ray_);
-            if (maybeIntersection)
-                ray = m::ray<double>(maybeIntersection->position * size + size / 2.0,
-                                     glm::normalize(ray_.direction));
-            else
+            m::dvec3 tDelta = m::abs(invDirection);
+            m::dvec3 tNext;
+            auto     computeNext = [&]()
             {
-                maybeIntersection = cubeIntersection<false>(ray_);
-                if (maybeIntersection)
-                    ray = m::ray<double>(ray_.origin * size + size / 2.0,
-                                         glm::normalize(ray_.direction));
-                else
-                    return std::nullopt;
-            }
+                for (int i = 0; i < 3; i++)
+                    tNext[i] = ray.direction[i] == 0 ? INFINITY : ((double)cell[i] + (step[i] > 0 ? 1 : 0) - ray.origin[i]) * invDirection[i];
+            };
+            computeNext();
+
+            // Moves to the cell right behind the exit of the empty box [lower, upper), returns false if the ray ends before
+            auto leap = [&](m::i64vec3 lower, m::i64vec3 upper)
+            {
+                lower = glm::max(lower, m::i64vec3(0));
+                upper = glm::min(upper, m::i64vec3(size));
 
-            // Setup
-            int g_x = (ray.direction.x < 0) ? 1 : 0;
-            int g_y = (ray.direction.y < 0) ? 1 : 0;
-            int g_z = (ray.direction.z < 0) ? 1 : 0;
+                m::dvec3 tBoxExit;
+                for (int i = 0; i < 3; i++)
+                    tBoxExit[i] = ray.direction[i] == 0 ? INFINITY : ((double)(step[i] > 0 ? upper[i] : lower[i]) - ray.origin[i]) * invDirection[i];
 
-            m::dvec3 u_x = calcU<0>(ray);
-            m::dvec3 u_y = calcU<1>(ray);
-            m::dvec3 u_z = calcU<2>(ray);
+                axis = tBoxExit.x < tBoxExit.y ? (tBoxExit.x < tBoxExit.z ? 0 : 2) : (tBoxExit.y < tBoxExit.z ? 1 : 2);
+                t = tBoxExit[axis];
+                if (t > tExit)
+                    return false;
 
-            m::dvec3 v_x = ray.direction * (ray.direction.x > 0 ? 1.0 : -1.0) / ray.direction.x;
-            m::dvec3 v_y = ray.direction * (ray.direction.y > 0 ? 1.0 : -1.0) / ray.direction.y;
-            m::dvec3 v_z = ray.direction * (ray.direction.z > 0 ? 1.0 : -1.0) / ray.direction.z;
+                cell = m::clamp(m::i64vec3(m::floor(ray(t))), lower, upper - m::i64vec3(1));
+                cell[axis] = step[axis] > 0 ? upper[axis] : lower[axis] - 1;
+                if (cell[axis] < 0 || cell[axis] >= (int64_t)size[axis])
+                    return false;
 
-            m::dvec3 r_x(ray.origin + u_x);
-            m::dvec3 r_y(ray.origin + u_y);
-            m::dvec3 r_z(ray.origin + u_z);
+                computeNext();
+                return true;
+            };
 
-            // PIXEL_LOGGER_LOG(ray,
-            //                  ", u_x: ", u_x,
-            //                  ", u_y: ", u_y,
-            //                  ", u_z: ", u_z,
-            //                  ", v_x: ", v_x,
-            //                  ", v_y: ", v_y,
-            //                  ", v_z: ", v_z, ", ");
+            const m::i64vec3 brickSize(VoxelGrid::BrickSize);
 
+            bool testCell = !startsInside;
             while (true)
             {
-                if (r_x.x < r_y.x != (bool)g_x && r_x.x < r_z.x != (bool)g_x)
-                {
-                    m::u64vec3 pos(m::round(r_x.x) - g_x, m::floor(r_x.y), m::floor(r_x.z));
-                    // PIXEL_LOGGER_LOG("(", pos, ", ", r_x, "), ");
-                    if (!(pos.x < size.x && pos.x >= 0 && pos.y < size.y && pos.y >= 0 && pos.z < size.z && pos.z >= 0))
-                        break;
-                    if (grid.at(pos).colorIndex)
-                        return Intersection{
-                            .position = (r_x - size / 2.0) / size,
-                            .normal = m::dvec3(g_x ? 1 : -1, 0, 0),
-                            .object = (SceneShape *)this,
-                            .sampleInfo = {
-                                .type = SampleInfoType::Index,
-                                .asIndex = (unsigned)grid.at(pos).colorIndex,
-                            },
-                        };
-                    r_x += v_x;
-                }
-                else if (r_y.y < r_z.y != (bool)g_y)
-                {
-                    m::u64vec3 pos(m::floor(r_y.x), m::round(r_y.y) - g_y, m::floor(r_y.z));
-                    // PIXEL_LOGGER_LOG("(", pos, ", ", r_y, "), ");
-                    if (!(pos.x < size.x && pos.x >= 0 && pos.y < size.y && pos.y >= 0 && pos.z < size.z && pos.z >= 0))
-                        break;
-                    if (grid.at(pos).colorIndex)
-                        return Intersection{
-                            .position = (r_y - size / 2.0) / size,
-                            .normal = m::dvec3(0, g_y ? 1 : -1, 0),
-                            .object = (SceneShape *)this,
-                            .sampleInfo = {
-                                .type = SampleInfoType::Index,
-                                .asIndex = (unsigned)grid.at(pos).colorIndex,
-                            },
-                        };
-                    r_y += v_y;
-                }
-                else
+                steps++;
+
+                if (testCell)
                 {
-                    m::u64vec3 pos(m::floor(r_z.x), m::floor(r_z.y), m::round(r_z.z) - g_z);
-                    // PIXEL_LOGGER_LOG("(", pos, ", ", r_z, "), ");
-                    if (!(pos.x < size.x && pos.x >= 0 && pos.y < size.y && pos.y >= 0 && pos.z < size.z && pos.z >= 0))
+                    unsigned char colorIndex = 0;
+                    switch (resource.acceleration)
+                    {
+                    case Acceleration::Dense:
+                        colorIndex = grid.at(m::u64vec3(cell)).colorIndex;
                         break;
-                    if (grid.at(pos).colorIndex)
-                        return Intersection{
-                            .position = (r_z - size / 2.0) / size,
-                            .normal = m::dvec3(0, 0, g_z ? 1 : -1),
-                            .object = (SceneShape *)this,
-                            .sampleInfo = {
-                                .type = SampleInfoType::Index,
-                                .asIndex = (unsigned)grid.at(pos).colorIndex,
-                            },
-                        };
-                    r_z += v_z;
+                    case Acceleration::BrickMap:
+                    {
+                        auto *brick = grid.getBrick(m::u64vec3(cell / brickSize));
+                        if (!brick)
+                        {
+                            m::i64vec3 lower = (cell / brickSize) * brickSize;
+                            if (!leap(lower, lower + brickSize))
+                                return std::nullopt;
+                            continue;
+                        }
+
+                        size_t index = VoxelGrid::indexInBrick(m::u64vec3(cell));
+                        if (brick->isFilled(index))
+                            colorIndex = brick->voxels[brick->voxelIndex(index)].colorIndex;
+                    }
+                    break;
+                    case Acceleration::DistanceField:
+                    {
+                        // Every cell closer than the distance is empty
+                        int64_t distance = resource.distanceAt(m::u64vec3(cell));
+                        if (distance > 1)
+                        {
+                            if (!leap(cell - m::i64vec3(distance - 1), cell + m::i64vec3(distance)))
+                                return std::nullopt;
+                            continue;
+                        }
+                        if (distance == 0)
+                            colorIndex = grid.at(m::u64vec3(cell)).colorIndex;
+                    }
+                    break;
+                    }
+
+                    if (colorIndex)
+                    {
+                        VoxelHit hit{.t = t, .normal = m::dvec3(0), .colorIndex = colorIndex};
+                        hit.normal[axis] = (double)-step[axis];
+                        return hit;
+                    }
                 }
+                testCell = true;
+
+                axis = tNext.x < tNext.y ? (tNext.x < tNext.z ? 0 : 2) : (tNext.y < tNext.z ? 1 : 2);
+                t = tNext[axis];
+                if (t > tExit)
+                    return std::nullopt;
+
+                cell[axis] += step[axis];
+                if (cell[axis] < 0 || cell[axis] >= (int64_t)size[axis])
+                    return std::nullopt;
+                tNext[axis] += tDelta[axis];
             }
+        }
 
-            // PIXEL_LOGGER_LOG("No voxel was hit!\n");
+        RT_KERNEL(std::optional<VoxelHit>, castVoxelRay, (const Resources::VoxelGridResource &resource, const m::ray<double> &localRay, double tMax, size_t &steps), (resource, localRay, tMax, steps))
 
-            return std::nullopt;
+        std::optional<Intersection> VoxelShape::intersect(const m::ray<double> &ray) const
+        {
+            return intersect(ray, INFINITY);
+        }
+
+        std::optional<Intersection> VoxelShape::intersect(const m::ray<double> &ray, double tMax) const
+        {
+            if (!grid)
+                return std::nullopt;
+
+            size_t steps = 0;
+            auto   hit = castVoxelRay(*grid, ray, tMax, steps);
+            RayStats::count(RayStats::VoxelSteps, steps);
+            PIXEL_LOGGER_LOG("Voxel steps: ", steps, ", ");
+            if (!hit)
+                return std::nullopt;
+
+            return Intersection{
+                .position = ray(hit->t),
+                .normal = hit->normal,
+                .t = hit->t,
+                .object = (SceneShape *)this,
+                .sampleInfo = {
+                    .type = SampleInfoType::Index,
+                    .asIndex = (unsigned)hit->colorIndex,
+                },
+            };
+        }
+
+        bool VoxelShape::occludes(const m::ray<double> &ray, double tMax) const
+        {
+            if (!grid)
+                return false;
+
+            size_t steps = 0;
+            auto   hit = castVoxelRay(*grid, ray, tMax, steps);
+            RayStats::count(RayStats::VoxelSteps, steps);
+            PIXEL_LOGGER_LOG("Voxel shadow steps: ", steps, ", ");
+            return hit.has_value();
+        }
+
+        std::optional<m::AABB<double>> VoxelShape::getLocalBounds() const
+        {
+            // The grid is always mapped onto the unit cube, but only its filled part can be hit
+            if (grid && grid->occupiedBounds)
+                return *grid->occupiedBounds;
+            return m::AABB<double>(m::dvec3(-0.5), m::dvec3(0.5));
         }
 
         bool VoxelShape::onInspectorGUI()
@@ -281,7 +441,11 @@ namespace rt
             bool changed = false;
 
             changed |= SceneShape::onInspectorGUI();
-            changed |= rtImGui::ResourceBox("Voxel Grid", grid);
+            if (rtImGui::ResourceBox("Voxel Grid", grid))
+            {
+                markChanged();
+                changed = true;
+            }
 
             return changed;
         }
@@ -11,6 +11,15 @@ namespace rt
         cached.matrix = m::scale(m::translate(m::dmat4(1), position) * glm::toMat4(rotation), scale);
         cached.inverseMatrix = m::inverse(cached.matrix);
         cached.inverseTransposeMatrix = m::transpose(cached.inverseMatrix);
+        m_cachedRevision = m_revision;
+    }
+
+    bool Transform::updateCache() const
+    {
+        if (m_cachedRevision == m_revision)
+            return false;
+        cacheMatrix();
+        return true;
     }
 
     std::ostream &operator<<(std::ostream &stream, const Transform &transform)
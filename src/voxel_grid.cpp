@@ -0,0 +1,72 @@
+#include <voxel_grid.h>
+
+namespace rt
+{
+    void VoxelGrid::set(const m::u64vec3 &position, Voxel voxel)
+    {
+        auto      brickPosition = position >> m::u64vec3(BrickBits);
+        uint32_t &brickIndex = m_brickMap[brickPosition.x + brickPosition.y * m_brickCount.x + brickPosition.z * m_brickCount.x * m_brickCount.y];
+
+        if (brickIndex == EmptyBrick)
+        {
+            // Empty voxels in empty bricks are not stored at all
+            if (!voxel.colorIndex)
+                return;
+            brickIndex = (uint32_t)m_bricks.size();
+            m_bricks.emplace_back();
+        }
+
+        Brick &brick = m_bricks[brickIndex];
+
+        size_t index = indexInBrick(position);
+        size_t word = index / 64;
+        auto   bit = uint64_t(1) << (index % 64);
+        auto   voxelIt = brick.voxels.begin() + brick.voxelIndex(index);
+
+        if (brick.isFilled(index))
+        {
+            if (voxel.colorIndex)
+            {
+                *voxelIt = voxel;
+                return;
+            }
+            brick.voxels.erase(voxelIt);
+            brick.occupancy[word] &= ~bit;
+            for (size_t i = word + 1; i < brick.rank.size(); i++)
+                brick.rank[i]--;
+        }
+        else if (voxel.colorIndex)
+        {
+            brick.voxels.insert(voxelIt, voxel);
+            brick.occupancy[word] |= bit;
+            for (size_t i = word + 1; i < brick.rank.size(); i++)
+                brick.rank[i]++;
+        }
+    }
+
+    std::optional<m::AABB<double>> VoxelGrid::getOccupiedBounds() const
+    {
+        m::AABB<double> bounds;
+        for (size_t z = 0; z < m_brickCount.z; z++)
+            for (size_t y = 0; y < m_brickCount.y; y++)
+                for (size_t x = 0; x < m_brickCount.x; x++)
+                {
+                    const Brick *brick = getBrick({x, y, z});
+                    if (!brick)
+                        continue;
+
+                    m::dvec3 origin = m::dvec3(x, y, z) * (double)BrickSize;
+                    for (size_t index = 0; index < BrickVolume; index++)
+                        if (brick->isFilled(index))
+                        {
+                            m::dvec3 cell = origin + m::dvec3(index & (BrickSize - 1), (index >> BrickBits) & (BrickSize - 1), index >> (2 * BrickBits));
+                            bounds.grow(cell);
+                            bounds.grow(cell + m::dvec3(1));
+                        }
+                }
+
+        if (bounds.isEmpty())
+            return std::nullopt;
+        return bounds;
+    }
+} // namespace rt
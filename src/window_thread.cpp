@@ -370,13 +370,50 @@ namespace rt
                     }
                 }
 
-                // Render button
-                ImGui::BeginDisabled(!m_application.outputPath || m_application.renderThread.isRendering());
+                // Render button, outputs are rendered as jobs in the background
+                static int priority = 0;
+                ImGui::InputInt("Priority", &priority);
+                ImGui::BeginDisabled(!m_application.outputPath);
                 if (ImGui::Button("Render output") && m_application.outputPath)
                 {
-                    m_application << Application::Events::RenderOutput(*m_application.outputPath, m_application.outputSize);
+                    m_application << Application::Events::RenderOutput(*m_application.outputPath, m_application.outputSize, priority);
                 }
                 ImGui::EndDisabled();
+
+                // Jobs
+                auto jobs = m_application.renderJobs.getJobs();
+                if (!jobs.empty())
+                {
+                    ImGui::SeparatorText("Jobs");
+                    for (auto &&job : jobs)
+                    {
+                        ImGui::PushID((int)job.id);
+
+                        char overlay[64];
+                        snprintf(overlay, sizeof(overlay), "%.1f%%", 100 * job.progress);
+                        ImGui::ProgressBar(job.progress, ImVec2(120, 0), overlay);
+                        ImGui::SameLine();
+                        ImGui::Text("%s (%d)", job.name.c_str(), job.priority);
+                        ImGui::SameLine();
+                        if (job.state == RenderJobQueue::JobState::Running && job.remaining)
+                            ImGui::Text("%.1f s, ETA %.1f s", job.elapsed, *job.remaining);
+                        else if (job.state == RenderJobQueue::JobState::Failed)
+                            ImGui::Text("failed: %s", job.error.c_str());
+                        else
+                            ImGui::Text("%s, %.1f s", jobStateToString(job.state), job.elapsed);
+
+                        if (job.state == RenderJobQueue::JobState::Queued || job.state == RenderJobQueue::JobState::Running)
+                        {
+                            ImGui::SameLine();
+                            if (ImGui::SmallButton("Cancel"))
+                                m_application.renderJobs.cancel(job.id);
+                        }
+
+                        ImGui::PopID();
+                    }
+                    if (ImGui::Button("Clear done"))
+                        m_application.renderJobs.clearDone();
+                }
             }
 
             if (ImGui::CollapsingHeader("Parameters", ImGuiTreeNodeFlags_DefaultOpen))
@@ -389,10 +426,74 @@ namespace rt
                 ImGui::SliderScalar("Tile size", ImGuiDataType_U64, &tileSize.x, &min, &max);
                 tileSize.y = tileSize.x;
 
+                if (ImGui::BeginCombo("Tile order", tileOrderToString(renderParams.tileOrder)))
+                {
+                    for (size_t i = 0; i < RenderParams::TileOrder_COUNT; i++)
+                        if (ImGui::Selectable(tileOrderToString((RenderParams::TileOrder)i), renderParams.tileOrder == i))
+                            renderParams.tileOrder = (RenderParams::TileOrder)i;
+                    ImGui::EndCombo();
+                }
+                ImGui::Checkbox("Split expensive tiles", &renderParams.splitExpensiveTiles);
+
+                // Shown in place of the preview image, outputs only get a heatmap next to them with --heatmap
+                if (ImGui::BeginCombo("Heatmap", heatmapToString(renderParams.heatmap)))
+                {
+                    for (size_t i = 0; i < RenderParams::Heatmap_COUNT; i++)
+                        if (ImGui::Selectable(heatmapToString((RenderParams::Heatmap)i), renderParams.heatmap == i))
+                        {
+                            renderParams.heatmap = (RenderParams::Heatmap)i;
+                            changed = true;
+                        }
+                    ImGui::EndCombo();
+                }
+
+                auto *renderer = m_application.renderThread.getRenderer();
+                if (renderer && !m_application.renderThread.isRendering())
+                {
+                    auto &stats = renderer->getTileStats();
+                    ImGui::Text("Tiles: %zu (%zu split), %.2f ms", stats.tileCount, stats.splitCount, stats.frameTime);
+                    ImGui::Text("Idle: %.2f ms over %zu workers (%.1f%%)", stats.idleTime, stats.workerCount,
+                                stats.frameTime > 0 ? 100.0 * stats.idleTime / (stats.workerCount * stats.frameTime) : 0.0);
+
+                    auto &rayStats = renderer->getRayStats();
+                    ImGui::Text("%.2f Mrays/s, %llu intersection tests", rayStats.getMraysPerSecond(stats.frameTime), (unsigned long long)rayStats.getIntersectionTests());
+                    if (ImGui::TreeNode("Ray statistics"))
+                    {
+                        for (size_t i = 0; i < RayStats::Counter_COUNT; i++)
+                            ImGui::Text("%s: %llu", rayCounterToString((RayStats::Counter)i), (unsigned long long)rayStats[(RayStats::Counter)i]);
+
+                        // Rays per recursion depth, up to the deepest one, that was reached
+                        float  depths[RayStats::MaxDepth];
+                        size_t depthCount = 0;
+                        for (size_t i = 0; i < RayStats::MaxDepth; i++)
+                        {
+                            depths[i] = (float)rayStats.depths[i];
+                            if (rayStats.depths[i] != 0)
+                                depthCount = i + 1;
+                        }
+                        ImGui::PlotHistogram("Recursion depth", depths, (int)depthCount, 0, nullptr, 0, FLT_MAX, ImVec2(0, 60));
+                        ImGui::TreePop();
+                    }
+                }
+
                 changed |= rtImGui::Drag("Mixing factor", renderParams.mixingFactor, 0.01f);
 
                 changed |= ImGui::InputScalar("Recursion depth", ImGuiDataType_U32, &renderParams.recursionDepth, &((const int &)1));
 
+                const size_t packetSizes[] = {1, 4, 8, 16};
+                if (ImGui::BeginCombo("Packet size", renderParams.packetSize == 1 ? "Off" : std::to_string(renderParams.packetSize).c_str()))
+                {
+                    for (size_t size : packetSizes)
+                    {
+                        if (ImGui::Selectable(size == 1 ? "Off" : std::to_string(size).c_str(), renderParams.packetSize == size))
+                        {
+                            renderParams.packetSize = size;
+                            changed = true;
+                        }
+                    }
+                    ImGui::EndCombo();
+                }
+
                 ImGui::SeparatorText("Tone mapping");
 
                 if (ImGui::BeginCombo("Tone mapping algorithm", toneMappingAlgorithmToString(renderParams.toneMappingAlgorithm)))
@@ -535,6 +636,7 @@ namespace rt
                 if (!m_application.renderThread.isRendering() && Profiling::profiler.getProfile() != nullptr)
                     profile = Profiling::profiler.exchangeProfile();
 
+                rtImGui::drawFrameReport(Profiling::profiler.getReport());
                 if (profile)
                     rtImGui::drawProfiler("Profiler", *profile, ImGui::GetContentRegionAvail().y);
             }